@@ -1,92 +1,688 @@
 #define _XOPEN_SOURCE 700
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <climits>
+#include <cerrno>
 #include <cmath>
+#include <cstdarg>
+#include <cstdint>
 #include <condition_variable>
+#include <coroutine>
+#include <cstdio>
 #include <cstdlib>
+#include <cctype>
 #include <cstring>
+#include <dirent.h>
 #include <ctime>
+#include <fcntl.h>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <ncurses.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <unistd.h>
 #include <vector>
 
 constexpr int MAX_BULLETS = 64;
 constexpr int MAX_ENEMIES = 64;
-constexpr int MAX_GAME_MODES = 2;
+constexpr int FORMATION_MAX_COLS = 16;
+constexpr int FORMATION_MAX_ROWS = 16;
 
 constexpr float PLAYER_MOVEMENT_SPEED = 1.2f;
 constexpr float PLAYER_BULLET_SPEED = 0.8f;
 constexpr float ENEMY_BULLET_SPEED = 0.6f;
 
-// Configuración para los dos modos de juego
-constexpr int MODE1_TOTAL_ENEMIES = 40;
-constexpr int MODE2_TOTAL_ENEMIES = 50;
-constexpr int MODE1_GROUP_SIZE = 8;
-constexpr int MODE2_GROUP_SIZE = 10;
+// Configuración común a los modos de juego (ver MODES)
 constexpr int GROUPS_PER_MODE = 5;
 constexpr int ENEMY_MOVEMENT_INTERVAL = 8;
+constexpr int DIVE_LAUNCH_TICKS = 60; // Ticks promedio entre picadas
 constexpr int ENEMY_SHOOTING_PROBABILITY =
     6; // Probabilidad de que dispare un enemigo.
 constexpr int ENEMY_SHOOTING_DENOMINATOR = 1000;
+// Probabilidad de disparo en picada, sobre ENEMY_SHOOTING_DENOMINATOR
+constexpr int DIVE_SHOOTING_PROBABILITY = 30;
 constexpr int UPDATE_INTERVAL_MS = 30; // Intervalo de actualización del juego
 constexpr int RENDER_INTERVAL_MS = 25;
 constexpr int INPUT_INTERVAL_MS = 10; // Intervalo de input del usuario
 constexpr int MOVEMENT_TIMEOUT_MS =
     80; // Tiempo en el que se continua movimiento después de última tecla
 constexpr int DAMAGE_FLASH_DURATION_MS = 500;
+constexpr int SCORE_CHECK_MS = 100; // Revisión del puntaje (vidas bonus)
+// Perfil de bajo ancho de banda (sesiones SSH lentas)
+constexpr long LOWBW_DEFAULT_BYTES_PER_SEC = 2400;
+constexpr int LOWBW_FAR_REFRESH_DIVISOR =
+    4; // Las filas lejanas a la nave se refrescan 1 de cada N cuadros
 
 struct Bullet {
   float x = 0, y = 0;
+  float prev_y = 0; // posición en el tick anterior, para interpolar
   bool active = false;
 };
 
 struct Enemy {
+  // Posición durante una picada; en formación se usa enemy_x()/enemy_y()
   float x = 0, y = 0;
+  // Lugar en la formación, relativo a su origen
+  float off_x = 0, off_y = 0;
   bool alive = false;
-  int row = 0;
+  int row = 0, col = 0;
+  int dive_path = -1; // patrón de ataque en curso, -1 = en formación
+  float dive_t = 0;   // índice en la tabla de la trayectoria
+  int dive_dir = 1;   // 1 o -1 (trayectoria en espejo)
+  long long next_shot = 0; // pasada de disparo en que dispara
+  int fire_slot = -1;      // lugar en el montículo de disparos, -1 = ninguno
 };
 
 struct EnemyBullet {
   float x = 0, y = 0;
+  float prev_y = 0;
   bool active = false;
 };
 
-static int screen_w, screen_h;
+/**
+ * Formación de enemigos
+ * Los enemigos en formación no guardan su posición: están en el origen más
+ * su desplazamiento, así marchar o bajar es mover el origen. Los vivos por
+ * fila y columna mantienen los extremos de la caja de los vivos al morir
+ * cada enemigo, y el choque con las paredes y el límite de descenso se
+ * prueban contra esa caja sin recorrer los enemigos.
+ */
+struct Formation {
+  float x = 0, y = 0;
+  float col_dx[FORMATION_MAX_COLS] = {}; // desplazamiento de cada columna
+  int col_alive[FORMATION_MAX_COLS] = {};
+  int row_alive[FORMATION_MAX_ROWS] = {};
+  int min_col = 0, max_col = -1; // vacía si min_col > max_col
+  int max_row = -1;
+};
+
+/**
+ * Estado de una partida. Todo lo que antes era estático del archivo vive en
+ * un GameWorld, así varias simulaciones pueden correr a la vez en el mismo
+ * proceso; cada sistema recibe el mundo por referencia.
+ * WorldData contiene solo datos planos (copiables byte a byte).
+ */
+struct WorldData {
+  int screen_w = 0, screen_h = 0;
+  // Sirve para limitar que tanto bajan los enemigos en la pantalla.
+  int max_enemy_y = 0;
+
+  int player_score = 0;
+  int player_lives = 3;
+  int game_mode = 1;
+  int current_group = 0;
+  int enemies_destroyed = 0;
+  int enemies_in_current_group = 0;
+  bool game_completed = false;
+
+  float ship_fx = 0;
+  float prev_ship_fx = 0;
+  int ship_x = 0, ship_y = 0;
+  Bullet bullets[MAX_BULLETS];
+  Enemy enemies[MAX_ENEMIES];
+  EnemyBullet ebullets[MAX_BULLETS];
+  Formation formation;
+
+  // Estado propio de los sistemas
+  int enemy_direction = 1;
+  int enemy_tick_counter = 0;
+  int score_last_seen = 0;
+  int autopilot_fire_cooldown = 0;
+  float dive_cooldown = 0; // ticks hasta la próxima picada
+  // Pasadas del sistema de disparo y enemigos vivos ordenados por next_shot
+  // (montículo de mínimos)
+  long long shoot_pass = 0;
+  int fire_heap[MAX_ENEMIES] = {};
+  int fire_heap_size = 0;
+
+  // Generador pseudoaleatorio de la partida (xorshift32)
+  uint32_t rng_state = 1;
+};
+
+/**
+ * Partículas de explosiones y daño
+ * Pool de capacidad fija con los campos en arreglos separados (SoA) usado
+ * como anillo: cada partícula nueva ocupa el lugar siguiente y, si el pool
+ * está lleno, reemplaza a la más vieja. Por tick se aceptan a lo sumo
+ * PARTICLE_FRAME_BUDGET partículas nuevas; el resto se descarta. Así el costo
+ * de actualizar y dibujar queda acotado por PARTICLE_CAPACITY.
+ */
+constexpr int PARTICLE_CAPACITY = 192;
+constexpr int PARTICLE_FRAME_BUDGET = 48;
+constexpr int EXPLOSION_PARTICLES = 12;
+constexpr int HIT_PARTICLES = 8;
+constexpr int INTERCEPT_PARTICLES = 4;
+constexpr float PARTICLE_GRAVITY = 0.03f;
+
+struct ParticlePool {
+  float x[PARTICLE_CAPACITY];
+  float y[PARTICLE_CAPACITY];
+  float vx[PARTICLE_CAPACITY];
+  float vy[PARTICLE_CAPACITY];
+  uint8_t life[PARTICLE_CAPACITY] = {}; // ticks restantes, 0 = libre
+  char glyph[PARTICLE_CAPACITY];
+  unsigned char color[PARTICLE_CAPACITY];
+  int head = 0;  // próximo lugar a escribir
+  int count = 0; // lugares en uso, los `count` anteriores a head
+  int spawned_this_tick = 0;
+  long long evicted = 0;
+  long long dropped = 0;
+  // Generador propio para no alterar la secuencia de la partida
+  uint32_t rng_state = 0x2545f491u;
+  std::mutex mutex;
+};
+
+/**
+ * Rueda de temporizadores jerárquica
+ * Los efectos con duración y los plazos se programan en ticks de simulación
+ * en lugar de tener hilos que consulten el reloj. El nivel l tiene
+ * TIMER_SLOTS ranuras y guarda los temporizadores que vencen dentro de menos
+ * de TIMER_SLOTS^(l+1) ticks, en la ranura que indican los bits del nivel en
+ * su vencimiento. Programar y cancelar es O(1) (listas intrusivas); cuando
+ * un nivel da la vuelta se redistribuye la ranura actual del siguiente.
+ */
+constexpr int TIMER_SLOT_BITS = 6;
+constexpr int TIMER_SLOTS = 1 << TIMER_SLOT_BITS;
+constexpr int TIMER_LEVELS = 4;
+
+struct GameWorld;
+
+struct TimerNode {
+  TimerNode *next = nullptr;
+  TimerNode **pprev = nullptr; // nullptr = no programado
+  long long expires = 0;       // tick en que vence
+  void (*fn)(GameWorld &) = nullptr;
+};
+
+struct TimerWheel {
+  std::mutex mutex;
+  long long now = 0; // último tick procesado
+  TimerNode *slots[TIMER_LEVELS][TIMER_SLOTS] = {};
+  TimerNode *due = nullptr; // vencidos que falta ejecutar
+};
+
+/**
+ * Guiones de enemigos
+ * El comportamiento de un enemigo fuera de la formación es una corrutina que
+ * el ScriptRunner reanuda una vez por tick; el guion espera con
+ * co_await script_sleep(n) y termina al volver a su lugar. Así cada patrón
+ * (esperar, picar, barrer, ráfaga, volver) se escribe como un bucle
+ * secuencial, sin un hilo ni una máquina de estados por enemigo.
+ * Los marcos de las corrutinas salen de un pool de bloques de tamaño fijo
+ * del propio mundo, así lanzar y terminar guiones no usa el heap. Un marco
+ * que no entra en el bloque (o un pool agotado) cae al heap y se cuenta en
+ * heap_frames. Cada guion tiene una guarda (el alive del enemigo): si se
+ * apaga, el runner destruye la corrutina sin reanudarla.
+ */
+constexpr size_t SCRIPT_BLOCK_BYTES = 256;
+
+// Cabecera de cada marco; alineada para no desalinear el marco que sigue
+struct alignas(16) ScriptFrameHeader {
+  struct ScriptPool *pool; // nullptr = marco en el heap
+  int block;
+};
+
+struct ScriptPool {
+  explicit ScriptPool(int capacity)
+      : blocks(new unsigned char[capacity * SCRIPT_BLOCK_BYTES]) {
+    free_blocks.reserve(capacity);
+    for (int i = capacity - 1; i >= 0; i--)
+      free_blocks.push_back(i);
+  }
+  std::unique_ptr<unsigned char[]> blocks;
+  std::vector<int> free_blocks; // pila de bloques libres
+  long long heap_frames = 0;
+  size_t max_frame_bytes = 0;
+};
+
+static void *script_frame_alloc(ScriptPool &pool, size_t n) {
+  size_t total = sizeof(ScriptFrameHeader) + n;
+  pool.max_frame_bytes = std::max(pool.max_frame_bytes, n);
+  ScriptFrameHeader *h;
+  if (total <= SCRIPT_BLOCK_BYTES && !pool.free_blocks.empty()) {
+    int block = pool.free_blocks.back();
+    pool.free_blocks.pop_back();
+    h = reinterpret_cast<ScriptFrameHeader *>(pool.blocks.get() +
+                                              block * SCRIPT_BLOCK_BYTES);
+    h->pool = &pool;
+    h->block = block;
+  } else {
+    pool.heap_frames++;
+    h = static_cast<ScriptFrameHeader *>(::operator new(total));
+    h->pool = nullptr;
+  }
+  return h + 1;
+}
+
+static void script_frame_free(void *p) {
+  ScriptFrameHeader *h = static_cast<ScriptFrameHeader *>(p) - 1;
+  if (h->pool)
+    h->pool->free_blocks.push_back(h->block);
+  else
+    ::operator delete(h);
+}
+
+struct ScriptPromise;
+using ScriptHandle = std::coroutine_handle<ScriptPromise>;
+
+// Lo que devuelve un guion; script_start() toma posesión de la corrutina
+struct EnemyScript {
+  using promise_type = ScriptPromise;
+  ScriptHandle handle;
+};
+
+struct ScriptPromise {
+  int sleep = 0; // ticks pedidos en el último co_await script_sleep()
+
+  // El primer parámetro de todo guion es el mundo: de ahí sale el pool
+  template <typename World, typename... Args>
+  static void *operator new(size_t n, World &w, Args &&...) {
+    return script_frame_alloc(w.scripts.pool, n);
+  }
+  static void operator delete(void *p) { script_frame_free(p); }
+
+  EnemyScript get_return_object() {
+    return {ScriptHandle::from_promise(*this)};
+  }
+  // Arranca en el próximo paso del runner y queda suspendido al terminar
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  std::suspend_always final_suspend() noexcept { return {}; }
+  void return_void() {}
+  void unhandled_exception() { std::terminate(); }
+};
+
+struct ScriptSleep {
+  int ticks;
+  bool await_ready() const { return false; }
+  void await_suspend(ScriptHandle h) const { h.promise().sleep = ticks; }
+  void await_resume() const {}
+};
+
+// Suspende el guion n ticks (al menos uno)
+static inline ScriptSleep script_sleep(int ticks) {
+  return {std::max(1, ticks)};
+}
+
+/**
+ * Guiones activos en arreglos paralelos: el paso recorre wake y guard, que
+ * son contiguos, y solo toca el marco de los que se reanudan. Un guion que
+ * termina ocupa el lugar del último.
+ */
+struct ScriptRunner {
+  explicit ScriptRunner(int capacity)
+      : pool(capacity), handles(capacity), wake(capacity), guard(capacity) {}
+  ~ScriptRunner();
+  ScriptPool pool;
+  std::vector<ScriptHandle> handles;
+  std::vector<long long> wake; // tick en que se reanuda
+  std::vector<const bool *> guard;
+  int count = 0;
+  long long tick = 0;
+  long long resumes = 0;
+};
+
+// Agrega un guion; si no hay lugar lo descarta y devuelve false
+static bool script_start(ScriptRunner &r, EnemyScript s, const bool *guard) {
+  if (r.count == static_cast<int>(r.handles.size())) {
+    s.handle.destroy();
+    return false;
+  }
+  r.handles[r.count] = s.handle;
+  r.wake[r.count] = r.tick + 1;
+  r.guard[r.count] = guard;
+  r.count++;
+  return true;
+}
+
+static void script_remove(ScriptRunner &r, int i) {
+  r.handles[i].destroy();
+  r.count--;
+  r.handles[i] = r.handles[r.count];
+  r.wake[i] = r.wake[r.count];
+  r.guard[i] = r.guard[r.count];
+}
+
+// Avanza un tick: reanuda los guiones que vencen y quita los terminados
+static void script_runner_step(ScriptRunner &r) {
+  r.tick++;
+  for (int i = 0; i < r.count;) {
+    if (!*r.guard[i]) {
+      script_remove(r, i);
+      continue;
+    }
+    if (r.wake[i] > r.tick) {
+      i++;
+      continue;
+    }
+    ScriptHandle h = r.handles[i];
+    h.resume();
+    r.resumes++;
+    if (h.done()) {
+      script_remove(r, i);
+      continue;
+    }
+    r.wake[i] = r.tick + h.promise().sleep;
+    i++;
+  }
+}
+
+static void script_runner_clear(ScriptRunner &r) {
+  while (r.count > 0)
+    script_remove(r, r.count - 1);
+}
+
+ScriptRunner::~ScriptRunner() { script_runner_clear(*this); }
+
+/**
+ * Pausa
+ * Con 'p' cada hilo del juego termina su tick y se bloquea en la variable de
+ * condición; el de entrada espera la tecla con un getch() bloqueante y el
+ * render dibuja un último cuadro con el aviso. Así una sesión en pausa no se
+ * despierta hasta la próxima tecla. Al reanudar, cada TickPacer vuelve a
+ * contar desde ese momento: no hay ticks atrasados que recuperar.
+ */
+struct PauseGate {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<bool> paused{false};
+};
+
+// Bloquea mientras haya pausa; devuelve true si tuvo que esperar
+static bool pause_park(PauseGate &g) {
+  if (!g.paused.load())
+    return false;
+  std::unique_lock<std::mutex> lock(g.mutex);
+  g.cv.wait(lock, [&g] { return !g.paused.load(); });
+  return true;
+}
+
+static void pause_set(PauseGate &g, bool paused) {
+  {
+    std::lock_guard<std::mutex> lock(g.mutex);
+    g.paused = paused;
+  }
+  g.cv.notify_all();
+}
+
+struct GameWorld : WorldData {
+  std::atomic<bool> game_running{true};
+  std::atomic<bool> player_hit{false};
+  std::atomic<bool> enemy_stop_descent{false};
+  // El usuario pidió salir con 'q' (y no terminó el juego por vidas/victoria)
+  std::atomic<bool> user_quit{false};
+
+  // Para recibir el input del usuario
+  std::atomic<bool> move_left{false};
+  std::atomic<bool> move_right{false};
+  std::atomic<bool> want_fire{false};
+  // Si el usuario esta manteniendo presionada la tecla.
+  std::atomic<int> held_key{0};
+  // Latencia de entrada: momento (us) en que input_loop() leyó la tecla más
+  // antigua que todavía no aplicó player_update_step(), o 0
+  std::atomic<long long> input_key_us{0};
+  // Tecla ya aplicada que todavía no llegó a un cuadro (bajo
+  // game_state_mutex): lectura y aplicación en us, o 0
+  long long input_applied_key_us = 0;
+  long long input_applied_us = 0;
+
+  // Ticks de simulación ejecutados (para medir ticks/s)
+  std::atomic<long long> sim_ticks{0};
+  // Momento del último tick de cada sistema que mueve algo, para que el
+  // render interpole entre el estado anterior y el actual
+  std::atomic<long long> ship_tick_ms{0};
+  std::atomic<long long> bullet_tick_ms{0};
+  std::atomic<long long> ebullet_tick_ms{0};
+
+  // Sincronización de hilos. Si se toman varios, en este orden:
+  // bullet_mutex, enemy_mutex, score_mutex, game_state_mutex. bullet_mutex
+  // protege las balas de ambos lados.
+  std::mutex game_state_mutex;
+  std::mutex bullet_mutex;
+  std::mutex enemy_mutex;
+  std::mutex score_mutex;
+  std::atomic<int> semaphore_bullets{1};
+  std::atomic<int> semaphore_enemies{1};
+
+  std::condition_variable cv_level_complete;
+
+  // Temporizadores; la rueda avanza con el tick de la nave (update_loop)
+  TimerWheel timers;
+  TimerNode flash_timer;    // fin del parpadeo de daño
+  TimerNode movement_timer; // la nave se detiene sin teclas de movimiento
+  TimerNode state_timer;    // revisa el estado tras perder una vida
+  TimerNode effects_timer;  // partículas, cada tick
+  TimerNode score_timer;    // revisión del puntaje, cada SCORE_CHECK_MS
+
+  // Solo efectos visuales: no se guardan ni existen sin interfaz
+  bool particles_enabled = false;
+  ParticlePool particles;
+  // Solo el mundo de la partida con interfaz registra telemetría
+  bool telemetry_enabled = false;
+
+  // Guiones de los enemigos fuera de la formación (bajo enemy_mutex); no se
+  // guardan: al cargar, los que estaban afuera vuelven a su lugar
+  ScriptRunner scripts{MAX_ENEMIES};
+
+  PauseGate pause;
+};
+
+static inline void world_seed(WorldData &w, uint32_t seed) {
+  w.rng_state = seed ? seed : 0x9e3779b9u;
+}
+
+// Reemplazo de std::rand() con estado por mundo: [0, 2^31)
+static inline int world_rand(WorldData &w) {
+  uint32_t x = w.rng_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  w.rng_state = x;
+  return static_cast<int>(x >> 1);
+}
+
+// Lugar en la formación y posición actual de un enemigo
+static inline float enemy_home_x(const WorldData &w, const Enemy &e) {
+  return w.formation.x + e.off_x;
+}
+static inline float enemy_home_y(const WorldData &w, const Enemy &e) {
+  return w.formation.y + e.off_y;
+}
+static inline float enemy_x(const WorldData &w, const Enemy &e) {
+  return e.dive_path >= 0 ? e.x : enemy_home_x(w, e);
+}
+static inline float enemy_y(const WorldData &w, const Enemy &e) {
+  return e.dive_path >= 0 ? e.y : enemy_home_y(w, e);
+}
+
+/**
+ * Disparos enemigos programados
+ * Cada pasada del sistema de disparo es un intento con probabilidad p por
+ * enemigo. En vez de sortear cada enemigo en cada pasada, se sortea una sola
+ * vez cuántas pasadas faltan para su próximo disparo (distribución
+ * geométrica) y los enemigos esperan en un montículo de mínimos: cada pasada
+ * solo atiende a los que disparan. Como la geométrica no tiene memoria, al
+ * cambiar p (empieza o termina una picada) se vuelve a sortear desde la
+ * pasada actual sin alterar la frecuencia de disparo.
+ */
+static inline bool fire_before(const WorldData &w, int a, int b) {
+  const Enemy &ea = w.enemies[a], &eb = w.enemies[b];
+  return ea.next_shot < eb.next_shot ||
+         (ea.next_shot == eb.next_shot && a < b);
+}
+
+static inline void fire_heap_set(WorldData &w, int slot, int e) {
+  w.fire_heap[slot] = e;
+  w.enemies[e].fire_slot = slot;
+}
+
+static void fire_heap_sift_up(WorldData &w, int slot) {
+  int e = w.fire_heap[slot];
+  while (slot > 0) {
+    int parent = (slot - 1) / 2;
+    if (!fire_before(w, e, w.fire_heap[parent]))
+      break;
+    fire_heap_set(w, slot, w.fire_heap[parent]);
+    slot = parent;
+  }
+  fire_heap_set(w, slot, e);
+}
 
-// Esta variable sirve para limitar que tanto bajan los enemigos en la pantalla.
-static int MAX_ENEMY_Y = 0;
+static void fire_heap_sift_down(WorldData &w, int slot) {
+  int e = w.fire_heap[slot];
+  while (true) {
+    int child = 2 * slot + 1;
+    if (child >= w.fire_heap_size)
+      break;
+    if (child + 1 < w.fire_heap_size &&
+        fire_before(w, w.fire_heap[child + 1], w.fire_heap[child]))
+      child++;
+    if (!fire_before(w, w.fire_heap[child], e))
+      break;
+    fire_heap_set(w, slot, w.fire_heap[child]);
+    slot = child;
+  }
+  fire_heap_set(w, slot, e);
+}
+
+// Sortea la próxima pasada en que dispara el enemigo e según su estado
+static void fire_schedule(WorldData &w, int e) {
+  Enemy &en = w.enemies[e];
+  int probability = en.dive_path >= 0 ? DIVE_SHOOTING_PROBABILITY
+                                      : ENEMY_SHOOTING_PROBABILITY;
+  double p = static_cast<double>(probability) / ENEMY_SHOOTING_DENOMINATOR;
+  double u = (world_rand(w) + 1.0) / 2147483648.0; // en (0, 1]
+  // Pasadas sin disparar antes del próximo: P(k >= m) = (1 - p)^m
+  long long k = static_cast<long long>(std::log(u) / std::log1p(-p));
+  en.next_shot = w.shoot_pass + 1 + k;
+  if (en.fire_slot < 0) {
+    fire_heap_set(w, w.fire_heap_size++, e);
+    fire_heap_sift_up(w, en.fire_slot);
+  } else {
+    fire_heap_sift_up(w, en.fire_slot);
+    fire_heap_sift_down(w, en.fire_slot);
+  }
+}
+
+static void fire_unschedule(WorldData &w, int e) {
+  int slot = w.enemies[e].fire_slot;
+  if (slot < 0)
+    return;
+  w.enemies[e].fire_slot = -1;
+  int last = w.fire_heap[--w.fire_heap_size];
+  if (slot == w.fire_heap_size)
+    return;
+  fire_heap_set(w, slot, last);
+  fire_heap_sift_up(w, slot);
+  fire_heap_sift_down(w, w.enemies[last].fire_slot);
+}
+
+// Marca un enemigo como muerto y achica la caja de la formación si era el
+// último vivo de una columna o fila del borde
+static inline void formation_kill(WorldData &w, Enemy &e) {
+  Formation &f = w.formation;
+  e.alive = false;
+  fire_unschedule(w, static_cast<int>(&e - w.enemies));
+  f.col_alive[e.col]--;
+  f.row_alive[e.row]--;
+  while (f.min_col <= f.max_col && f.col_alive[f.min_col] == 0)
+    f.min_col++;
+  while (f.max_col >= f.min_col && f.col_alive[f.max_col] == 0)
+    f.max_col--;
+  while (f.max_row >= 0 && f.row_alive[f.max_row] == 0)
+    f.max_row--;
+}
+
+static inline float particle_rand(ParticlePool &p) {
+  uint32_t x = p.rng_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  p.rng_state = x;
+  return static_cast<float>(x >> 8) / static_cast<float>(1u << 24);
+}
 
-static std::atomic<bool> game_running{true};
-static int player_score = 0;
-static int player_lives = 3;
-static int game_mode = 1;
-static int current_group = 0;
-static int enemies_destroyed = 0;
-static int enemies_in_current_group = 0;
-static bool game_completed = false;
-static std::atomic<bool> player_hit{false};
-static long long damage_flash_start_ms = 0;
+// Lanza n partículas desde (x, y) en todas direcciones
+static void spawn_particles(GameWorld &w, float x, float y, int n,
+                            const char *glyphs, unsigned char color) {
+  if (!w.particles_enabled)
+    return;
+  ParticlePool &p = w.particles;
+  std::lock_guard<std::mutex> lock(p.mutex);
+  int room = PARTICLE_FRAME_BUDGET - p.spawned_this_tick;
+  if (n > room) {
+    p.dropped += n - std::max(0, room);
+    n = std::max(0, room);
+  }
+  int nglyphs = static_cast<int>(std::strlen(glyphs));
+  for (int k = 0; k < n; k++) {
+    int i = p.head;
+    if (p.count == PARTICLE_CAPACITY) {
+      if (p.life[i] > 0)
+        p.evicted++;
+    } else {
+      p.count++;
+    }
+    float angle = particle_rand(p) * 6.2831853f;
+    float speed = 0.2f + particle_rand(p) * 0.6f;
+    p.x[i] = x;
+    p.y[i] = y;
+    p.vx[i] = std::cos(angle) * speed * 2.0f; // las celdas son más altas
+    p.vy[i] = std::sin(angle) * speed;
+    p.life[i] = static_cast<uint8_t>(8 + particle_rand(p) * 12);
+    p.glyph[i] = glyphs[k % nglyphs];
+    p.color[i] = color;
+    p.head = (p.head + 1) % PARTICLE_CAPACITY;
+  }
+  p.spawned_this_tick += n;
+}
 
-// Sincronización de hilos
-static std::mutex game_state_mutex;
-static std::mutex bullet_mutex;
-static std::mutex enemy_mutex;
-static std::mutex score_mutex;
-static std::atomic<int> semaphore_bullets{1};
-static std::atomic<int> semaphore_enemies{1};
+static void particles_step(GameWorld &w) {
+  ParticlePool &p = w.particles;
+  std::lock_guard<std::mutex> lock(p.mutex);
+  p.spawned_this_tick = 0;
+  int start = (p.head - p.count + PARTICLE_CAPACITY) % PARTICLE_CAPACITY;
+  for (int k = 0; k < p.count; k++) {
+    int i = (start + k) % PARTICLE_CAPACITY;
+    if (p.life[i] == 0)
+      continue;
+    p.x[i] += p.vx[i];
+    p.y[i] += p.vy[i];
+    p.vy[i] += PARTICLE_GRAVITY;
+    p.life[i]--;
+  }
+  // Liberar las más viejas ya apagadas
+  while (p.count > 0 && p.life[start] == 0) {
+    start = (start + 1) % PARTICLE_CAPACITY;
+    p.count--;
+  }
+}
 
-static std::condition_variable cv_game_state;
-static std::condition_variable cv_level_complete;
+static void particles_clear(GameWorld &w) {
+  std::lock_guard<std::mutex> lock(w.particles.mutex);
+  for (int i = 0; i < PARTICLE_CAPACITY; i++)
+    w.particles.life[i] = 0;
+  w.particles.count = 0;
+}
 
-static float ship_fx;
-static int ship_x, ship_y;
-static Bullet bullets[MAX_BULLETS];
-static Enemy enemies[MAX_ENEMIES];
-static EnemyBullet ebullets[MAX_BULLETS];
 
 // Sprites de los enemigos y del jugador.
 static const int SHIP_W = 7;
@@ -108,12 +704,126 @@ static inline const char **enemy_art_for_level(int lvl) {
   return (const char **)ENEMY_ART_LVL3;
 }
 
-// Para recibir el input del usuario
-static std::atomic<bool> move_left{false};
-static std::atomic<bool> move_right{false};
-static std::atomic<bool> want_fire{false};
-// Se guarda el ultimo evento de input como milisegundos.
-static std::atomic<long long> last_move_ms{0};
+/**
+ * Máscaras de colisión
+ * Por cada fila de un sprite, un bit por columna con un carácter que no es
+ * espacio (bit 0 = columna izquierda). Se arman al iniciar a partir del arte,
+ * así una bala solo acierta donde hay algo dibujado; la prueba es un
+ * desplazamiento y un AND, tan barata como comparar contra el rectángulo.
+ */
+constexpr int SPRITE_MAX_H = 2;
+constexpr int ART_LEVELS = 3;
+static_assert(SHIP_H <= SPRITE_MAX_H && ENEMY_H <= SPRITE_MAX_H,
+              "Sprite más alto que SPRITE_MAX_H");
+static_assert(SHIP_W <= 32 && ENEMY_W <= 32, "Sprite más ancho que la máscara");
+
+struct SpriteMask {
+  uint32_t rows[SPRITE_MAX_H];
+  int w, h;
+};
+static SpriteMask ship_mask;
+static SpriteMask enemy_masks[ART_LEVELS + 1]; // por nivel de arte, 1..3
+
+static SpriteMask sprite_mask(const char *const *art, int w, int h) {
+  SpriteMask m{};
+  m.w = w;
+  m.h = h;
+  for (int r = 0; r < h; r++)
+    for (int c = 0; c < w && art[r][c]; c++)
+      if (art[r][c] != ' ')
+        m.rows[r] |= 1u << c;
+  return m;
+}
+
+static void build_sprite_masks() {
+  ship_mask = sprite_mask(SHIP_ART, SHIP_W, SHIP_H);
+  for (int lvl = 1; lvl <= ART_LEVELS; lvl++)
+    enemy_masks[lvl] = sprite_mask(enemy_art_for_level(lvl), ENEMY_W, ENEMY_H);
+}
+
+// La celda (bx, by) cae sobre un carácter del sprite dibujado en (sx, sy)
+static inline bool sprite_hit(const SpriteMask &m, int sx, int sy, int bx,
+                              int by) {
+  unsigned row = static_cast<unsigned>(by - sy);
+  unsigned col = static_cast<unsigned>(bx - sx);
+  return row < static_cast<unsigned>(m.h) &&
+         col < static_cast<unsigned>(m.w) && (m.rows[row] >> col & 1u);
+}
+
+// Columna donde compose_frame() dibuja cada sprite; las colisiones usan la
+// misma para que coincidan con lo que se ve
+static inline int enemy_draw_x(int ex, int screen_w) {
+  return std::min(std::max(ex - 1, 0), screen_w - ENEMY_W);
+}
+static inline int ship_draw_x(int ship_x, int screen_w) {
+  return std::min(std::max(ship_x - SHIP_W / 2, 0), screen_w - SHIP_W);
+}
+
+/**
+ * Descriptores de modo de juego
+ * Todo lo que cambia según el modo está en MODES; agregar un modo es agregar
+ * una entrada. Los sistemas por tick se instancian por modo (plantillas sobre
+ * el índice en MODES), así tamaños y límites son constantes en su ruta y los
+ * recorridos de enemigos se limitan al tamaño del grupo.
+ */
+struct ModeDesc {
+  int group_size;
+  int enemies_per_row;
+  int max_divers; // enemigos en picada a la vez
+  int art_level;  // ver enemy_art_for_level()
+
+  constexpr int total_enemies() const { return group_size * GROUPS_PER_MODE; }
+  constexpr int rows() const {
+    return (group_size + enemies_per_row - 1) / enemies_per_row;
+  }
+};
+
+constexpr ModeDesc MODES[] = {
+    {8, 4, 2, 1},
+    {10, 5, 3, 2},
+};
+constexpr int MAX_GAME_MODES = sizeof(MODES) / sizeof(MODES[0]);
+
+constexpr bool modes_fit_enemy_array() {
+  for (const ModeDesc &m : MODES)
+    if (m.group_size > MAX_ENEMIES || m.enemies_per_row > FORMATION_MAX_COLS ||
+        m.rows() > FORMATION_MAX_ROWS)
+      return false;
+  return true;
+}
+static_assert(modes_fit_enemy_array(),
+              "Un grupo no cabe en el arreglo de enemigos o la formación");
+
+// Modos numerados desde 1, como game_mode
+static constexpr const ModeDesc &mode_desc(int mode) {
+  return MODES[mode - 1];
+}
+
+// Los modos existentes conservan el arte (y la máscara) de su número
+constexpr bool modes_keep_art_level() {
+  for (int m = 1; m <= MAX_GAME_MODES && m <= ART_LEVELS; m++)
+    if (mode_desc(m).art_level != m)
+      return false;
+  return true;
+}
+static_assert(modes_keep_art_level(),
+              "El arte de un modo no coincide con su número");
+
+struct GameWorld;
+using SystemFn = void (*)(GameWorld &);
+
+// Tabla con una instancia de un sistema por modo, generada desde MODES:
+// gen(std::integral_constant<int, I>) devuelve la instancia del modo I.
+template <typename Gen, int... I>
+constexpr std::array<SystemFn, sizeof...(I)>
+make_mode_table(Gen gen, std::integer_sequence<int, I...>) {
+  return {{gen(std::integral_constant<int, I>{})...}};
+}
+
+template <typename Gen> constexpr auto mode_table(Gen gen) {
+  return make_mode_table(gen,
+                         std::make_integer_sequence<int, MAX_GAME_MODES>{});
+}
 
 static inline long long now_ms() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -121,745 +831,4341 @@ static inline long long now_ms() {
       .count();
 }
 
-// Si el usuario esta manteniendo presionada la tecla.
-static std::atomic<int> held_key{0};
+static inline long long now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
 
 // Buffer para que la pantalla no parpadee.
 static WINDOW *backwin = nullptr;
 
-static std::atomic<bool> enemy_stop_descent{false};
+// Opciones de línea de comandos
+static bool opt_stats_overlay = false;
+static long opt_lowbw_bytes_per_sec = 0; // 0 = perfil normal
+static bool opt_autopilot = false;
+static bool opt_headless = false;
+static int opt_autopilot_games = 0; // 0 = sin límite (con interfaz)
+static int opt_headless_mode = 1;
+static int opt_headless_w = 80;
+static int opt_headless_h = 24;
+static int opt_batch_games = 0; // > 0 = modo por lotes
+static int opt_batch_jobs = 1;
+static int opt_bench_divers = 0;    // > 0 = benchmark de picadas
+static int opt_bench_intercept = 0; // > 0 = benchmark de intercepción
+static int opt_bench_scripts = 0;   // > 0 = benchmark de guiones
+static const char *opt_pty_bench_sizes = nullptr;
+static int opt_pty_seconds = 10;
+static bool opt_alloc_check = false;
+static uint32_t opt_seed = 0;
+static const char *opt_record_path = nullptr;
 
-// Para guardar los puntajes mas altos
-static int saved_highscore = 0;
-static const char *HIGHSCORE_FILENAME = "galaga_highscores.txt";
+// Duración del tick de simulación (--tick-ms). Las velocidades por tick se
+// escalan para que el juego avance igual en tiempo real; el render interpola.
+static int opt_tick_ms = UPDATE_INTERVAL_MS;
+static float tick_scale = 1.0f;
+static int enemy_movement_interval_ticks = ENEMY_MOVEMENT_INTERVAL;
+constexpr int MIN_TICK_MS = 10;
+// Con ticks más largos las balas saltarían filas y no colisionarían
+constexpr int MAX_TICK_MS = 50;
 
-static std::string highscore_path() {
-  // Guardar en el folder actual
-  return std::string(HIGHSCORE_FILENAME);
+static void set_tick_ms(int ms) {
+  opt_tick_ms = ms;
+  tick_scale = static_cast<float>(ms) / UPDATE_INTERVAL_MS;
+  enemy_movement_interval_ticks = std::max(
+      1, (ENEMY_MOVEMENT_INTERVAL * UPDATE_INTERVAL_MS + ms / 2) / ms);
 }
+static const char *opt_play_path = nullptr;
+static const char *opt_load_state_path = nullptr;
+static bool opt_watch = false;
+static int opt_watch_pid = 0; // 0 = la partida más reciente
+static bool opt_no_spectators = false;
 
-static std::vector<int> load_highscores() {
-  std::vector<int> res(3, 0);
-  std::string p = highscore_path();
-  std::ifstream in(p);
-  if (!in)
-    return res;
-  for (int i = 0; i < 3 && in; i++) {
-    int v;
-    in >> v;
-    if (in)
-      res[i] = v;
+/**
+ * Medidor de bytes enviados a la terminal.
+ * Los cuadros salen por term_out, un FILE* de fopencookie que cuenta cada byte
+ * y lo reenvía a STDOUT_FILENO. El backend ANSI escribe ahí directamente.
+ * ncurses (6.x) ignora el FILE* que recibe y escribe con write(2) sobre su
+ * fd, así que su pantalla se abre con newterm() sobre un dup propio de la
+ * terminal y, mientras dura doupdate(), ese fd apunta a un memfd cuyo
+ * contenido se pasa después por term_out (ver term_capture_*).
+ */
+static std::atomic<long long> term_bytes_total{0};
+
+struct TermMeter {
+  long long frame_bytes = 0;    // bytes del último cuadro enviado
+  long long frames_sent = 0;    // cuadros enviados (doupdate)
+  long long frames_skipped = 0; // cuadros fusionados por falta de presupuesto
+  long long frame_bytes_sum = 0; // bytes de todos los cuadros de juego
+  long long rate_window_start_ms = 0;
+  long long rate_window_bytes = 0;
+  long long bytes_per_sec = 0; // medido en la última ventana de 1 s
+  // Cubeta de tokens del perfil de bajo ancho de banda
+  double tokens = 0;
+  long long last_refill_ms = 0;
+  long long frame_counter = 0;
+};
+static TermMeter term_meter;
+
+static FILE *term_out = nullptr;
+static FILE *curses_out = nullptr; // salida de ncurses: dup de STDOUT_FILENO
+static int term_capture_fd = -1;   // memfd que recibe cada doupdate()
+
+static ssize_t term_out_write(void *, const char *buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = write(STDOUT_FILENO, buf + done, len - done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    done += static_cast<size_t>(n);
   }
-  return res;
+  term_bytes_total.fetch_add(static_cast<long long>(done),
+                             std::memory_order_relaxed);
+  return done > 0 ? static_cast<ssize_t>(done) : -1;
 }
 
-static void save_highscores(const std::vector<int> &hs) {
-  std::string p = highscore_path();
-  std::ofstream out(p, std::ios::trunc);
-  if (!out)
+// Abre term_out (sin buffer: cada fwrite es una escritura) y el memfd de
+// captura; sin memfd ncurses escribe directo y sus cuadros no se cuentan
+static void term_out_open() {
+  if (term_out)
     return;
-  for (int i = 0; i < 3; i++)
-    out << hs[i] << "\n";
+  cookie_io_functions_t io = {nullptr, term_out_write, nullptr, nullptr};
+  term_out = fopencookie(nullptr, "w", io);
+  if (term_out)
+    setvbuf(term_out, nullptr, _IONBF, 0);
+  term_capture_fd = memfd_create("galaga-term", MFD_CLOEXEC);
 }
 
-// Se guarda si se alcanzo un puntaje mas alto de los existentes.
-static void update_highscores_if_needed(int sc) {
-  auto hs = load_highscores();
-  for (int i = 0; i < 3; i++) {
-    if (sc > hs[i]) {
-      for (int j = 2; j > i; j--)
-        hs[j] = hs[j - 1];
-      hs[i] = sc;
-      save_highscores(hs);
-      saved_highscore = hs[0];
-      return;
-    }
+// Desvía la salida de ncurses al memfd
+static void term_capture_begin() {
+  if (term_capture_fd >= 0 && term_out && curses_out)
+    dup2(term_capture_fd, fileno(curses_out));
+}
+
+// Devuelve ncurses a la terminal y envía por term_out lo capturado
+static void term_capture_end() {
+  if (term_capture_fd < 0 || !term_out || !curses_out)
+    return;
+  dup2(STDOUT_FILENO, fileno(curses_out));
+  static char buf[1 << 16];
+  off_t len = lseek(term_capture_fd, 0, SEEK_CUR);
+  for (off_t off = 0; off < len;) {
+    ssize_t n = pread(term_capture_fd, buf,
+                      static_cast<size_t>(std::min<off_t>(len - off,
+                                                          sizeof(buf))),
+                      off);
+    if (n <= 0)
+      break;
+    std::fwrite(buf, 1, static_cast<size_t>(n), term_out);
+    off += n;
   }
-  saved_highscore = hs[0];
+  if (ftruncate(term_capture_fd, 0) == 0)
+    lseek(term_capture_fd, 0, SEEK_SET);
 }
 
-// Inicializa el modo de juego seleccionado
-void init_game_mode(int mode) {
-  game_mode = mode;
-  current_group = 0;
-  enemies_destroyed = 0;
-  enemies_in_current_group = 0;
-  game_completed = false;
+/**
+ * Conteo de asignaciones en el heap
+ * Con -DGALAGA_ALLOC_TRACKING (make alloc-check) se reemplazan operator new y
+ * delete para contar cada asignación, en total y por hilo. El juego en estado
+ * estable (ticks y cuadros) no debe asignar nada; --alloc-check lo verifica.
+ */
+#ifdef GALAGA_ALLOC_TRACKING
+static std::atomic<long long> heap_allocs_total{0};
+static thread_local long long heap_allocs_thread = 0;
+
+void *operator new(size_t n) {
+  heap_allocs_total.fetch_add(1, std::memory_order_relaxed);
+  heap_allocs_thread++;
+  if (void *p = std::malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n) { return operator new(n); }
+// noinline: si se expande free() junto a un operator new, GCC lo marca como
+// par new/free incorrecto (-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
 }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
 
-// Inicializa el estado del juego y configura la pantalla
-void init_game() {
-  getmaxyx(stdscr, screen_h, screen_w);
-  clear();
-  refresh();
-  ship_x = screen_w / 2;
-  ship_y = std::max(3, screen_h - SHIP_H - 1);
-  for (int i = 0; i < MAX_BULLETS; i++)
-    bullets[i] = Bullet{};
-  for (int i = 0; i < MAX_ENEMIES; i++)
-    enemies[i] = Enemy{};
-  for (int i = 0; i < MAX_BULLETS; i++)
-    ebullets[i] = EnemyBullet{};
-  ship_fx = static_cast<float>(screen_w) / 2.0f;
-  ship_x = static_cast<int>(std::round(ship_fx));
-  std::srand(static_cast<unsigned>(std::time(nullptr)));
-  player_score = 0;
-  player_lives = 3;
-  game_running = true;
-  player_hit = false;
-  enemy_stop_descent.store(false);
-  // Crear buffer fuera de pantalla
-  if (backwin) {
-    delwin(backwin);
-    backwin = nullptr;
+constexpr bool ALLOC_TRACKING = true;
+static inline long long heap_allocs() { return heap_allocs_total.load(); }
+static inline long long thread_heap_allocs() { return heap_allocs_thread; }
+#else
+constexpr bool ALLOC_TRACKING = false;
+static inline long long heap_allocs() { return 0; }
+static inline long long thread_heap_allocs() { return 0; }
+#endif
+
+/**
+ * Trazas de actividad de los hilos (--trace ARCHIVO)
+ * Cada hilo anota sus intervalos (iteraciones de los sistemas, esperas por
+ * mutex y fases del render) en un buffer propio, sin bloqueos. Al salir se
+ * vuelcan como JSON de Chrome trace, que abren Perfetto y chrome://tracing.
+ * Sin --trace ningún hilo tiene buffer y cada intervalo cuesta solo leer una
+ * variable thread_local.
+ */
+constexpr int TRACE_MAX_THREADS = 64;
+constexpr uint32_t TRACE_EVENTS_PER_THREAD = 1u << 18;
+constexpr int TRACE_NAME_LEN = 32;
+
+struct TraceEvent {
+  const char *name; // siempre literales
+  const char *cat;
+  int64_t ts_us;
+  int64_t dur_us;
+};
+
+struct TraceBuffer {
+  char name[TRACE_NAME_LEN] = {};
+  // Sin inicializar: el sistema solo asigna las páginas que se usan
+  std::unique_ptr<TraceEvent[]> events;
+  std::atomic<uint32_t> count{0};
+  uint32_t dropped = 0;
+  bool in_use = false;
+};
+
+struct Tracer {
+  FILE *file = nullptr;
+  std::chrono::steady_clock::time_point start;
+  // Solo para asignar buffers cuando un hilo empieza o termina
+  std::mutex mutex;
+  int nbuffers = 0;
+  TraceBuffer buffers[TRACE_MAX_THREADS];
+};
+static std::unique_ptr<Tracer> tracer;
+static thread_local TraceBuffer *trace_buf = nullptr;
+static const char *opt_trace_path = nullptr;
+
+static inline int64_t trace_now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - tracer->start)
+      .count();
+}
+
+static inline void trace_record(const char *name, const char *cat,
+                                int64_t ts, int64_t dur) {
+  TraceBuffer &b = *trace_buf;
+  uint32_t n = b.count.load(std::memory_order_relaxed);
+  if (n >= TRACE_EVENTS_PER_THREAD) {
+    b.dropped++;
+    return;
   }
-  backwin = newwin(screen_h, screen_w, 0, 0);
-  // Calcular que tanto pueden bajar los enemigos.
-  MAX_ENEMY_Y = std::max(2, screen_h / 2 - ENEMY_H);
+  b.events[n] = TraceEvent{name, cat, ts, dur};
+  b.count.store(n + 1, std::memory_order_release);
 }
 
-// Genera enemigos en formación para el grupo especificado en el modo actual
-void spawn_enemies(int group_num) {
-  (void)group_num;
-  int group_size = (game_mode == 1) ? MODE1_GROUP_SIZE : MODE2_GROUP_SIZE;
-  int enemies_per_row = (game_mode == 1) ? 4 : 5;
-  int rows = 2;
+// Intervalo que va desde la construcción hasta el fin del alcance
+struct TraceSpan {
+  const char *name, *cat;
+  int64_t t0 = 0;
+  TraceSpan(const char *name, const char *cat) : name(name), cat(cat) {
+    if (trace_buf)
+      t0 = trace_now_us();
+  }
+  ~TraceSpan() {
+    if (trace_buf)
+      trace_record(name, cat, t0, trace_now_us() - t0);
+  }
+};
 
-  int idx = 0;
+/**
+ * Asigna un buffer al hilo actual mientras vive el objeto. Los hilos de cada
+ * partida se crean de nuevo, así que un hilo reutiliza el buffer libre con su
+ * mismo nombre y aparece en la misma pista de la traza.
+ */
+struct TraceThread {
+  explicit TraceThread(const char *name) {
+    if (!tracer)
+      return;
+    Tracer &t = *tracer;
+    std::lock_guard<std::mutex> lock(t.mutex);
+    TraceBuffer *buf = nullptr;
+    for (int i = 0; i < t.nbuffers && !buf; i++)
+      if (!t.buffers[i].in_use &&
+          std::strncmp(t.buffers[i].name, name, TRACE_NAME_LEN) == 0)
+        buf = &t.buffers[i];
+    if (!buf && t.nbuffers < TRACE_MAX_THREADS) {
+      buf = &t.buffers[t.nbuffers++];
+      std::snprintf(buf->name, sizeof(buf->name), "%s", name);
+      buf->events.reset(new TraceEvent[TRACE_EVENTS_PER_THREAD]);
+    }
+    if (buf)
+      buf->in_use = true;
+    trace_buf = buf;
+  }
+  ~TraceThread() {
+    if (!trace_buf)
+      return;
+    std::lock_guard<std::mutex> lock(tracer->mutex);
+    trace_buf->in_use = false;
+    trace_buf = nullptr;
+  }
+  TraceThread(const TraceThread &) = delete;
+  TraceThread &operator=(const TraceThread &) = delete;
+};
 
-  // Limpiar enemigos anteriores
-  for (int i = 0; i < MAX_ENEMIES; i++) {
-    enemies[i].alive = false;
+// Igual que std::lock_guard, pero anota cuánto se esperó por el mutex
+struct TracedLock {
+  std::mutex &m;
+  TracedLock(std::mutex &m, const char *name) : m(m) {
+    if (!trace_buf) {
+      m.lock();
+      return;
+    }
+    int64_t t0 = trace_now_us();
+    m.lock();
+    trace_record(name, "lock", t0, trace_now_us() - t0);
   }
+  ~TracedLock() { m.unlock(); }
+  TracedLock(const TracedLock &) = delete;
+  TracedLock &operator=(const TracedLock &) = delete;
+};
 
-  for (int r = 0; r < rows && idx < group_size; r++) {
-    for (int c = 0; c < enemies_per_row && idx < group_size; c++) {
-      enemies[idx].alive = true;
-      enemies[idx].x =
-          2 + c * static_cast<float>((screen_w - 4)) / enemies_per_row;
-      enemies[idx].y = 2 + r * (ENEMY_H + 1);
-      enemies[idx].row = r;
-      idx++;
+static bool tracer_open(const char *path) {
+  FILE *file = std::fopen(path, "w");
+  if (!file)
+    return false;
+  tracer.reset(new Tracer);
+  tracer->file = file;
+  tracer->start = std::chrono::steady_clock::now();
+  return true;
+}
+
+// Escribe la traza; llamar con todos los hilos trazados terminados
+static void tracer_close() {
+  if (!tracer)
+    return;
+  Tracer &t = *tracer;
+  FILE *out = t.file;
+  int pid = static_cast<int>(getpid());
+  long long total = 0, dropped = 0;
+  std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::fprintf(out,
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+               "\"args\":{\"name\":\"galaga\"}}",
+               pid);
+  for (int i = 0; i < t.nbuffers; i++) {
+    const TraceBuffer &b = t.buffers[i];
+    std::fprintf(out,
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 pid, i + 1, b.name);
+    uint32_t n = b.count.load(std::memory_order_acquire);
+    for (uint32_t k = 0; k < n; k++) {
+      const TraceEvent &e = b.events[k];
+      std::fprintf(out,
+                   ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                   "\"pid\":%d,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+                   e.name, e.cat, pid, i + 1,
+                   static_cast<long long>(e.ts_us),
+                   static_cast<long long>(e.dur_us));
     }
+    total += n;
+    dropped += b.dropped;
   }
+  std::fprintf(out, "\n]}\n");
+  std::fclose(out);
+  std::fprintf(stderr,
+               "Traza: %lld intervalos de %d hilos, %lld descartados\n",
+               total, t.nbuffers, dropped);
+  // El buffer del hilo que cierra ya no existe
+  trace_buf = nullptr;
+  tracer.reset();
+}
 
-  enemies_in_current_group = group_size;
+// Refresca la cubeta de tokens; true si hay presupuesto para enviar un cuadro
+static bool lowbw_frame_allowed() {
+  if (opt_lowbw_bytes_per_sec <= 0)
+    return true;
+  long long t = now_ms();
+  if (term_meter.last_refill_ms == 0)
+    term_meter.last_refill_ms = t;
+  double cap = static_cast<double>(opt_lowbw_bytes_per_sec) / 2.0;
+  term_meter.tokens +=
+      (t - term_meter.last_refill_ms) * opt_lowbw_bytes_per_sec / 1000.0;
+  if (term_meter.tokens > cap)
+    term_meter.tokens = cap;
+  term_meter.last_refill_ms = t;
+  return term_meter.tokens > 0;
 }
 
-// Reinicia el grupo actual
-void reset_level() {
-  for (int i = 0; i < MAX_BULLETS; i++) {
-    bullets[i].active = false;
-    bullets[i].x = 0;
-    bullets[i].y = 0;
-    ebullets[i].active = false;
-    ebullets[i].x = 0;
-    ebullets[i].y = 0;
+// Registra los bytes emitidos por un cuadro ya enviado
+static void term_meter_frame_sent(long long bytes) {
+  long long t = now_ms();
+  term_meter.frame_bytes = bytes;
+  term_meter.frames_sent++;
+  term_meter.frame_bytes_sum += bytes;
+  if (opt_lowbw_bytes_per_sec > 0)
+    term_meter.tokens -= static_cast<double>(bytes);
+  if (term_meter.rate_window_start_ms == 0)
+    term_meter.rate_window_start_ms = t;
+  term_meter.rate_window_bytes += bytes;
+  if (t - term_meter.rate_window_start_ms >= 1000) {
+    term_meter.bytes_per_sec = term_meter.rate_window_bytes * 1000 /
+                               (t - term_meter.rate_window_start_ms);
+    term_meter.rate_window_start_ms = t;
+    term_meter.rate_window_bytes = 0;
   }
-  spawn_enemies(current_group);
-  enemy_stop_descent.store(false);
 }
 
 /**
- * Hilo 1: Manejo de balas del jugador
- * Actualiza la posición de las balas del jugador y elimina las que salen de
- * pantalla
+ * Latencia de entrada a pantalla
+ * Cada tecla de movimiento o disparo se marca al leerla en input_loop(); la
+ * marca pasa a player_update_step() cuando el tick la aplica y el render la
+ * toma al capturar el estado. Al enviar ese cuadro (doupdate() o el write()
+ * del backend ANSI) se registra la latencia total y sus dos tramos:
+ * lectura -> tick (cadencia de la simulación) y tick -> cuadro (ritmo del
+ * render). Solo el hilo de render escribe los histogramas.
  */
-void *player_bullet_manager_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
+constexpr int LATENCY_BUCKET_US = 500;
+constexpr int LATENCY_BUCKETS = 500; // hasta 250 ms; la última acumula el resto
+
+struct LatencyHistogram {
+  long long buckets[LATENCY_BUCKETS] = {};
+  long long count = 0;
+  long long max_us = 0;
+};
+
+struct InputLatency {
+  LatencyHistogram total;    // lectura -> cuadro enviado
+  LatencyHistogram to_tick;  // lectura -> tick que la aplica
+  LatencyHistogram to_frame; // tick -> cuadro enviado
+  // Tecla capturada en el cuadro en curso, 0 si no hay
+  long long pending_key_us = 0;
+  long long pending_applied_us = 0;
+};
+static InputLatency input_latency;
+
+static void latency_record(LatencyHistogram &h, long long us) {
+  int b = static_cast<int>(std::max(0LL, us) / LATENCY_BUCKET_US);
+  h.buckets[std::min(b, LATENCY_BUCKETS - 1)]++;
+  h.count++;
+  h.max_us = std::max(h.max_us, us);
+}
+
+// Percentil p (0-1) en milisegundos: el límite superior de su cubeta, sin
+// pasar del máximo observado
+static double latency_percentile_ms(const LatencyHistogram &h, double p) {
+  long long target = static_cast<long long>(p * h.count), seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+    seen += h.buckets[b];
+    if (seen > target)
+      return std::min<long long>((b + 1) * LATENCY_BUCKET_US, h.max_us) /
+             1000.0;
+  }
+  return h.max_us / 1000.0;
+}
+
+// Llamado al enviar un cuadro: la tecla capturada ya está en pantalla
+static void input_latency_frame_sent() {
+  InputLatency &l = input_latency;
+  if (l.pending_key_us == 0)
+    return;
+  long long t = now_us();
+  latency_record(l.total, t - l.pending_key_us);
+  latency_record(l.to_tick, l.pending_applied_us - l.pending_key_us);
+  latency_record(l.to_frame, t - l.pending_applied_us);
+  l.pending_key_us = l.pending_applied_us = 0;
+}
+
+static void input_latency_print(FILE *out) {
+  const InputLatency &l = input_latency;
+  if (l.total.count == 0)
+    return;
+  std::fprintf(out,
+               "Latencia tecla -> cuadro: %lld teclas (entrada cada %d ms, "
+               "tick %d ms, render cada %d ms)\n",
+               l.total.count, INPUT_INTERVAL_MS, opt_tick_ms,
+               RENDER_INTERVAL_MS);
+  auto line = [out](const char *name, const LatencyHistogram &h) {
+    std::fprintf(out,
+                 "  %-16s p50 %5.1f ms, p95 %5.1f ms, p99 %5.1f ms, máx "
+                 "%5.1f ms\n",
+                 name, latency_percentile_ms(h, 0.50),
+                 latency_percentile_ms(h, 0.95),
+                 latency_percentile_ms(h, 0.99), h.max_us / 1000.0);
+  };
+  line("total", l.total);
+  line("lectura -> tick", l.to_tick);
+  line("tick -> cuadro", l.to_frame);
+}
+
+static inline bool use_colors() {
+  return has_colors() && opt_lowbw_bytes_per_sec <= 0;
+}
+
+/**
+ * Tabla de puntajes compartida
+ * Archivo de tamaño fijo mapeado con mmap (MAP_SHARED) que pueden usar varios
+ * procesos a la vez, coordinados con flock(): exclusivo para insertar,
+ * compartido para leer. Cada modo tiene LB_MAX_PER_MODE registros fijos y un
+ * índice ordenado por puntaje (desc) y fecha (asc), donde la posición de un
+ * registro nuevo se busca en O(log n).
+ * El índice está duplicado: se escribe la copia inactiva y luego se cambia
+ * `active` con un solo store, así un proceso que muere a mitad de una
+ * inserción nunca deja un índice corrupto.
+ */
+constexpr char LB_MAGIC[8] = {'G', 'L', 'G', 'L', 'B', 'R', 'D', '\0'};
+constexpr uint32_t LB_VERSION = 1;
+constexpr int LB_MODES = 8; // lugares reservados en el archivo
+constexpr int LB_MAX_PER_MODE = 1000;
+constexpr int LB_NAME_LEN = 24;
+static const char *LEADERBOARD_FILENAME = "galaga_leaderboard.db";
+
+static_assert(MAX_GAME_MODES <= LB_MODES,
+              "El archivo de puntajes no tiene lugar para todos los modos");
+
+struct LbRecord {
+  char name[LB_NAME_LEN];
+  int64_t date; // time_t
+  int32_t score;
+  int16_t groups;
+  uint8_t mode;
+  uint8_t won;
+};
+
+struct LbIndex {
+  uint32_t count;
+  uint32_t spare; // registro libre para la próxima inserción
+  uint16_t order[LB_MAX_PER_MODE];
+};
+
+struct LbModeBlock {
+  uint32_t active; // índice vigente, 0 o 1
+  LbIndex index[2];
+  LbRecord records[LB_MAX_PER_MODE + 1];
+};
+
+struct LbFile {
+  char magic[8];
+  uint32_t version;
+  uint32_t file_size;
+  LbModeBlock modes[LB_MODES];
+};
+
+static LbFile *lb_map = nullptr;
+static int lb_fd = -1;
+static const char *opt_leaderboard_path = LEADERBOARD_FILENAME;
+static const char *opt_player_name = nullptr;
+
+struct LbLock {
+  explicit LbLock(int op) { flock(lb_fd, op); }
+  ~LbLock() { flock(lb_fd, LOCK_UN); }
+};
+
+// Abre (o crea) el archivo; sin él el juego sigue sin tabla de puntajes
+static bool leaderboard_open(const char *path) {
+  lb_fd = open(path, O_RDWR | O_CREAT, 0664);
+  if (lb_fd < 0)
+    return false;
+  {
+    LbLock lock(LOCK_EX);
+    struct stat st;
+    bool ok = fstat(lb_fd, &st) == 0;
+    if (ok && st.st_size == 0)
+      ok = ftruncate(lb_fd, sizeof(LbFile)) == 0;
+    else if (ok && st.st_size != static_cast<off_t>(sizeof(LbFile)))
+      ok = false; // otra versión del formato
+    if (ok) {
+      void *p = mmap(nullptr, sizeof(LbFile), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, lb_fd, 0);
+      if (p != MAP_FAILED)
+        lb_map = static_cast<LbFile *>(p);
+    }
+    if (lb_map && lb_map->magic[0] == '\0') {
+      // Archivo nuevo: ftruncate lo dejó en ceros, que es un índice vacío
+      lb_map->version = LB_VERSION;
+      lb_map->file_size = sizeof(LbFile);
+      std::memcpy(lb_map->magic, LB_MAGIC, sizeof(LB_MAGIC));
+    }
+    if (lb_map && (std::memcmp(lb_map->magic, LB_MAGIC, 8) != 0 ||
+                   lb_map->version != LB_VERSION)) {
+      munmap(lb_map, sizeof(LbFile));
+      lb_map = nullptr;
+    }
+  }
+  if (!lb_map) {
+    close(lb_fd);
+    lb_fd = -1;
+  }
+  return lb_map != nullptr;
+}
+
+static void leaderboard_close() {
+  if (lb_map) {
+    munmap(lb_map, sizeof(LbFile));
+    close(lb_fd);
+    lb_map = nullptr;
+    lb_fd = -1;
+  }
+}
+
+// leaderboard_open solo valida la cabecera y el tamaño, así que los valores
+// del índice se acotan al leerlos: un archivo dañado muestra basura pero
+// nunca hace leer o escribir fuera de records
+static inline int lb_count(const LbIndex &idx) {
+  return static_cast<int>(
+      std::min<uint32_t>(idx.count, static_cast<uint32_t>(LB_MAX_PER_MODE)));
+}
+
+static inline uint16_t lb_slot(uint16_t slot) {
+  return std::min<uint16_t>(slot, LB_MAX_PER_MODE);
+}
+
+// Orden de la tabla: mayor puntaje primero y, a igual puntaje, el más antiguo
+static inline bool lb_before(const LbRecord &a, const LbRecord &b) {
+  return a.score != b.score ? a.score > b.score : a.date < b.date;
+}
+
+/**
+ * Inserta un registro en la tabla de su modo. Devuelve el puesto (desde 1) o
+ * 0 si no entra entre los LB_MAX_PER_MODE mejores: la tabla guarda solo esos,
+ * así que con la tabla llena una partida peor que la última no se registra y
+ * una mejor desplaza a la última.
+ * Solo la búsqueda del puesto es O(log n); la inserción completa es O(n) con
+ * n <= LB_MAX_PER_MODE, porque se copia el índice entero (2 KB) a la copia
+ * inactiva. Es el precio de que un proceso que muere a mitad de la inserción
+ * no deje el índice a medio desplazar.
+ */
+static int leaderboard_insert(const LbRecord &rec) {
+  if (!lb_map || rec.mode < 1 || rec.mode > MAX_GAME_MODES)
+    return 0;
+  LbLock lock(LOCK_EX);
+  LbModeBlock &m = lb_map->modes[rec.mode - 1];
+  const LbIndex &cur = m.index[m.active & 1];
+  LbIndex &next = m.index[(m.active & 1) ^ 1];
+
+  int count = lb_count(cur);
+  const uint16_t *begin = cur.order, *end = cur.order + count;
+  const uint16_t *pos = std::upper_bound(
+      begin, end, rec, [&](const LbRecord &r, uint16_t slot) {
+        return lb_before(r, m.records[lb_slot(slot)]);
+      });
+  int rank = static_cast<int>(pos - begin);
+  if (rank >= LB_MAX_PER_MODE)
+    return 0;
+
+  // El registro va al lugar libre, que ningún índice vigente referencia
+  uint16_t slot = static_cast<uint16_t>(
+      std::min<uint32_t>(cur.spare, static_cast<uint32_t>(LB_MAX_PER_MODE)));
+  m.records[slot] = rec;
+
+  int kept = std::min(count, LB_MAX_PER_MODE - 1);
+  next.count = kept + 1;
+  next.spare = count == LB_MAX_PER_MODE ? lb_slot(cur.order[count - 1])
+                                        : count + 1;
+  std::memcpy(next.order, cur.order, sizeof(uint16_t) * rank);
+  next.order[rank] = slot;
+  std::memcpy(next.order + rank + 1, cur.order + rank,
+              sizeof(uint16_t) * (kept - rank));
+  std::atomic_thread_fence(std::memory_order_release);
+  m.active = (m.active & 1) ^ 1;
+  return rank + 1;
+}
+
+constexpr int HIGHSCORE_COUNT = 3;
+constexpr int HIGHSCORES_REFRESH_MS = 1000; // Pantalla de puntajes abierta
+using Highscores = std::array<int, HIGHSCORE_COUNT>;
+
+// Mejores puntajes de un modo
+static Highscores load_highscores(int mode) {
+  Highscores res{};
+  if (!lb_map || mode < 1 || mode > MAX_GAME_MODES)
+    return res;
+  LbLock lock(LOCK_SH);
+  const LbModeBlock &m = lb_map->modes[mode - 1];
+  const LbIndex &idx = m.index[m.active & 1];
+  for (int i = 0; i < HIGHSCORE_COUNT && i < lb_count(idx); i++)
+    res[i] = m.records[lb_slot(idx.order[i])].score;
+  return res;
+}
+
+// Mejor puntaje del modo, para el HUD
+static int saved_highscore = 0;
+// Puesto de la última partida registrada (0 = fuera de la tabla)
+static int last_game_rank = 0;
+
+static const char *player_name() {
+  if (opt_player_name)
+    return opt_player_name;
+  const char *user = std::getenv("USER");
+  return user && *user ? user : "jugador";
+}
+
+// Registra una partida terminada; devuelve el puesto obtenido (0 = ninguno)
+static int leaderboard_record_game(int mode, int score, int groups, bool won) {
+  LbRecord rec{};
+  const char *name = player_name();
+  for (int i = 0; i < LB_NAME_LEN - 1 && name[i]; i++)
+    rec.name[i] = std::isprint(static_cast<unsigned char>(name[i])) ? name[i]
+                                                                    : '?';
+  rec.date = static_cast<int64_t>(std::time(nullptr));
+  rec.score = score;
+  rec.groups = static_cast<int16_t>(groups);
+  rec.mode = static_cast<uint8_t>(mode);
+  rec.won = won;
+  int rank = leaderboard_insert(rec);
+  saved_highscore = load_highscores(mode)[0];
+  return rank;
+}
+
+/**
+ * Telemetría de la sesión (--telemetry DIR)
+ * Los sistemas registran eventos (disparos, impactos, daño, grupos) en un
+ * anillo de un productor y un consumidor por hilo: registrar un evento son
+ * dos cargas atómicas y una copia, nunca bloquea, y si el anillo está lleno el
+ * evento se descarta y se cuenta. Un hilo escritor de baja prioridad vacía los
+ * anillos por lotes y escribe registros de tamaño fijo en un archivo por
+ * sesión, que --telemetry-summary agrega después.
+ */
+constexpr char TEL_MAGIC[8] = {'G', 'L', 'G', 'T', 'E', 'L', '1', '\0'};
+constexpr uint32_t TEL_VERSION = 1;
+constexpr int TEL_RING_EVENTS = 1024;
+constexpr int TEL_FLUSH_MS = 250;
+constexpr int TEL_WRITER_NICE = 10;
+
+enum TelEventType : uint8_t {
+  TEL_GAME_START = 1, // a = modo
+  TEL_GAME_END,       // a = ganó, b = puntaje
+  TEL_GROUP_START,
+  TEL_GROUP_CLEAR,
+  TEL_SHOT,       // a = balas del jugador activas
+  TEL_ENEMY_SHOT, // a = balas enemigas activas
+  TEL_KILL,       // a = fila del enemigo, b = puntaje
+  TEL_DAMAGE,     // a = vidas restantes
+  TEL_DROPPED     // a = eventos descartados (al cerrar la sesión)
+};
+
+// Un anillo por hilo productor; en el modo de un solo hilo todos comparten
+// el hilo pero nunca corren a la vez, así que sigue habiendo un productor
+enum TelSource {
+  TEL_SRC_MAIN,
+  TEL_SRC_UPDATE,
+  TEL_SRC_COLLISION,
+  TEL_SRC_ENEMY_SHOOT,
+  TEL_SRC_ENEMY_COLLISION,
+  TEL_SRC_LEVEL,
+  TEL_SRC_COUNT
+};
+
+struct TelEvent {
+  uint32_t t_ms; // desde el inicio de la sesión
+  uint16_t game; // partida dentro de la sesión
+  uint8_t type;
+  uint8_t group;
+  int32_t a, b;
+};
+static_assert(sizeof(TelEvent) == 16, "TelEvent debe ocupar 16 bytes");
+
+struct TelHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t event_size;
+  int64_t start_time; // time_t
+};
+
+struct TelRing {
+  TelEvent events[TEL_RING_EVENTS];
+  alignas(64) std::atomic<unsigned> head{0};
+  alignas(64) std::atomic<unsigned> tail{0};
+  std::atomic<long long> dropped{0};
+};
+
+struct Telemetry {
+  FILE *file = nullptr;
+  long long start_ms = 0;
+  int game = -1; // la escribe el hilo principal con los sistemas detenidos
+  std::thread writer;
+  std::atomic<bool> stop{false};
+  std::mutex mutex;
+  std::condition_variable cv;
+  TelRing rings[TEL_SRC_COUNT];
+  std::vector<TelEvent> batch;
+  long long events_written = 0;
+};
+// Solo se reserva cuando se pide --telemetry
+static std::unique_ptr<Telemetry> telemetry;
+static const char *opt_telemetry_dir = nullptr;
+
+template <typename B, size_t N> static int count_active(const B (&arr)[N]) {
+  int n = 0;
+  for (const B &b : arr)
+    n += b.active;
+  return n;
+}
+
+static void telemetry_event(GameWorld &w, TelSource src, TelEventType type,
+                            int a = 0, int b = 0) {
+  if (!w.telemetry_enabled)
+    return;
+  Telemetry &t = *telemetry;
+  TelRing &r = t.rings[src];
+  unsigned head = r.head.load(std::memory_order_relaxed);
+  if (head - r.tail.load(std::memory_order_acquire) >= TEL_RING_EVENTS) {
+    r.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TelEvent &e = r.events[head % TEL_RING_EVENTS];
+  e.t_ms = static_cast<uint32_t>(now_ms() - t.start_ms);
+  e.game = static_cast<uint16_t>(t.game);
+  e.type = type;
+  e.group = static_cast<uint8_t>(w.current_group);
+  e.a = a;
+  e.b = b;
+  r.head.store(head + 1, std::memory_order_release);
+}
+
+// Pasa a t.batch todo lo que haya en los anillos y lo escribe de una vez
+static void telemetry_drain(Telemetry &t) {
+  t.batch.clear();
+  for (TelRing &r : t.rings) {
+    unsigned tail = r.tail.load(std::memory_order_relaxed);
+    unsigned head = r.head.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+      t.batch.push_back(r.events[tail % TEL_RING_EVENTS]);
+    r.tail.store(tail, std::memory_order_release);
+  }
+  if (t.batch.empty())
+    return;
+  std::fwrite(t.batch.data(), sizeof(TelEvent), t.batch.size(), t.file);
+  t.events_written += static_cast<long long>(t.batch.size());
+}
+
+static void telemetry_writer_loop(Telemetry &t) {
+  // Prioridad baja solo para este hilo (en Linux nice es por hilo)
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+              TEL_WRITER_NICE);
+  while (!t.stop.load()) {
     {
-      std::lock_guard<std::mutex> lock(bullet_mutex);
-      for (int i = 0; i < MAX_BULLETS; i++) {
-        if (bullets[i].active) {
-          bullets[i].y -= PLAYER_BULLET_SPEED;
-          if (bullets[i].y < 1)
-            bullets[i].active = false;
+      std::unique_lock<std::mutex> lock(t.mutex);
+      t.cv.wait_for(lock, std::chrono::milliseconds(TEL_FLUSH_MS));
+    }
+    telemetry_drain(t);
+  }
+  telemetry_drain(t);
+}
+
+static bool telemetry_open(const char *dir) {
+  char path[PATH_MAX];
+  std::time_t now = std::time(nullptr);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+  std::snprintf(path, sizeof(path), "%s/galaga-%s-%d.tlm", dir, stamp,
+                static_cast<int>(getpid()));
+  FILE *file = std::fopen(path, "wb");
+  if (!file)
+    return false;
+  telemetry.reset(new Telemetry);
+  Telemetry &t = *telemetry;
+  t.file = file;
+  TelHeader hdr{};
+  std::memcpy(hdr.magic, TEL_MAGIC, sizeof(TEL_MAGIC));
+  hdr.version = TEL_VERSION;
+  hdr.event_size = sizeof(TelEvent);
+  hdr.start_time = static_cast<int64_t>(now);
+  std::fwrite(&hdr, sizeof(hdr), 1, t.file);
+  t.batch.reserve(TEL_SRC_COUNT * TEL_RING_EVENTS);
+  t.start_ms = now_ms();
+  t.writer = std::thread(telemetry_writer_loop, std::ref(t));
+  return true;
+}
+
+// Empieza una partida nueva en la sesión; con los hilos del juego detenidos
+static void telemetry_game_start(GameWorld &w) {
+  if (!w.telemetry_enabled)
+    return;
+  telemetry->game++;
+  telemetry_event(w, TEL_SRC_MAIN, TEL_GAME_START, w.game_mode);
+  telemetry_event(w, TEL_SRC_MAIN, TEL_GROUP_START);
+}
+
+static void telemetry_close() {
+  if (!telemetry)
+    return;
+  Telemetry &t = *telemetry;
+  t.stop = true;
+  t.cv.notify_one();
+  t.writer.join();
+  long long dropped = 0;
+  for (TelRing &r : t.rings)
+    dropped += r.dropped.load();
+  if (dropped > 0) {
+    TelEvent e{};
+    e.t_ms = static_cast<uint32_t>(now_ms() - t.start_ms);
+    e.type = TEL_DROPPED;
+    e.a = static_cast<int32_t>(std::min<long long>(dropped, INT32_MAX));
+    std::fwrite(&e, sizeof(e), 1, t.file);
+  }
+  std::fclose(t.file);
+  std::fprintf(stderr, "Telemetría: %lld eventos escritos, %lld descartados\n",
+               t.events_written, dropped);
+  telemetry.reset();
+}
+
+// Inicializa el modo de juego seleccionado
+void init_game_mode(GameWorld &w, int mode) {
+  w.game_mode = mode;
+  w.current_group = 0;
+  w.enemies_destroyed = 0;
+  w.enemies_in_current_group = 0;
+  w.game_completed = false;
+}
+
+// Debe llamarse con el mutex de la rueda tomado
+static void timer_link(TimerWheel &tw, TimerNode &t) {
+  long long diff = t.expires - tw.now;
+  int level = 0;
+  while (level < TIMER_LEVELS - 1 &&
+         diff >= 1LL << (TIMER_SLOT_BITS * (level + 1)))
+    level++;
+  int slot = static_cast<int>(t.expires >> (TIMER_SLOT_BITS * level)) &
+             (TIMER_SLOTS - 1);
+  TimerNode *&head = tw.slots[level][slot];
+  t.next = head;
+  if (head)
+    head->pprev = &t.next;
+  head = &t;
+  t.pprev = &head;
+}
+
+static void timer_unlink(TimerNode &t) {
+  if (!t.pprev)
+    return;
+  *t.pprev = t.next;
+  if (t.next)
+    t.next->pprev = t.pprev;
+  t.next = nullptr;
+  t.pprev = nullptr;
+}
+
+// Programa (o reprograma) t para dentro de `ticks` ticks, al menos uno
+static void timer_schedule(GameWorld &w, TimerNode &t,
+                           void (*fn)(GameWorld &), long long ticks) {
+  constexpr long long max_ticks = (1LL << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+  TimerWheel &tw = w.timers;
+  TracedLock lock(tw.mutex, "timer_mutex");
+  timer_unlink(t);
+  t.fn = fn;
+  t.expires = tw.now + std::min(max_ticks, std::max(1LL, ticks));
+  timer_link(tw, t);
+}
+
+static void timer_cancel(GameWorld &w, TimerNode &t) {
+  TracedLock lock(w.timers.mutex, "timer_mutex");
+  timer_unlink(t);
+}
+
+// Ticks que cubren al menos `ms` milisegundos con el tick actual
+static inline long long timer_ticks(int ms) {
+  return std::max(1, (ms + opt_tick_ms - 1) / opt_tick_ms);
+}
+
+static void timer_wheel_reset(GameWorld &w) {
+  TimerWheel &tw = w.timers;
+  TracedLock lock(tw.mutex, "timer_mutex");
+  for (auto &level : tw.slots)
+    for (TimerNode *&head : level)
+      while (head)
+        timer_unlink(*head);
+  while (tw.due)
+    timer_unlink(*tw.due);
+  tw.now = 0;
+}
+
+/**
+ * Avanza la rueda un tick y ejecuta los temporizadores vencidos, sin el
+ * mutex de la rueda tomado: pueden volver a programarse. Lo llama el hilo
+ * de la nave o simulate_tick().
+ */
+static void timer_wheel_advance(GameWorld &w) {
+  TimerWheel &tw = w.timers;
+  {
+    TracedLock lock(tw.mutex, "timer_mutex");
+    tw.now++;
+    for (int l = 1; l < TIMER_LEVELS; l++) {
+      int shift = TIMER_SLOT_BITS * l;
+      if (tw.now & ((1LL << shift) - 1))
+        break;
+      TimerNode *&head =
+          tw.slots[l][static_cast<int>(tw.now >> shift) & (TIMER_SLOTS - 1)];
+      TimerNode *t = head;
+      head = nullptr;
+      while (t) {
+        TimerNode *next = t->next;
+        timer_link(tw, *t);
+        t = next;
+      }
+    }
+    TimerNode *&slot = tw.slots[0][tw.now & (TIMER_SLOTS - 1)];
+    tw.due = slot;
+    if (slot)
+      slot->pprev = &tw.due;
+    slot = nullptr;
+  }
+  while (true) {
+    void (*fn)(GameWorld &);
+    {
+      TracedLock lock(tw.mutex, "timer_mutex");
+      if (!tw.due)
+        break;
+      fn = tw.due->fn;
+      timer_unlink(*tw.due);
+    }
+    fn(w);
+  }
+}
+
+// Fin del parpadeo rojo de la nave
+static void damage_flash_end(GameWorld &w) { w.player_hit = false; }
+
+// Pasaron MOVEMENT_TIMEOUT_MS sin teclas de movimiento
+static void movement_timeout(GameWorld &w) {
+  w.held_key.store(0);
+  w.move_left = false;
+  w.move_right = false;
+}
+
+/**
+ * Monitor de estado del juego
+ * Se programa al perder una vida y ve si le quedan vidas al jugador.
+ */
+static void game_state_check(GameWorld &w) {
+  TraceSpan span("game_state_step", "sistema");
+  TracedLock lock(w.game_state_mutex, "game_state_mutex");
+  if (w.player_lives <= 0)
+    w.game_running = false;
+}
+
+/**
+ * Gestor de puntuación
+ * Temporizador periódico que revisa el puntaje cada SCORE_CHECK_MS y otorga
+ * vidas bonus. Corre en el hilo que avanza la rueda, así que en pausa no se
+ * despierta.
+ */
+static void score_step(GameWorld &w) {
+  TraceSpan span("score_step", "sistema");
+  TracedLock lock(w.score_mutex, "score_mutex");
+  if (w.player_score != w.score_last_seen) {
+    w.score_last_seen = w.player_score;
+    // Agregar vida bonus cada 300 puntos
+    if (w.player_score > 0 && w.player_score % 300 == 0) {
+      TracedLock state_lock(w.game_state_mutex, "game_state_mutex");
+      if (w.player_lives < 5)
+        w.player_lives++;
+    }
+  }
+}
+
+static void score_tick(GameWorld &w) {
+  score_step(w);
+  timer_schedule(w, w.score_timer, score_tick, timer_ticks(SCORE_CHECK_MS));
+}
+
+// Efectos visuales: avanza las partículas y se reprograma para el tick
+// siguiente
+static void visual_effects_tick(GameWorld &w) {
+  TraceSpan span("visual_effects_step", "sistema");
+  particles_step(w);
+  timer_schedule(w, w.effects_timer, visual_effects_tick, 1);
+}
+
+// Inicializa el estado del juego para una pantalla de ancho x alto (sin
+// ncurses)
+void init_game_state(GameWorld &w, int width, int height, uint32_t seed) {
+  w.screen_w = width;
+  w.screen_h = height;
+  w.ship_x = w.screen_w / 2;
+  w.ship_y = std::max(3, w.screen_h - SHIP_H - 1);
+  for (int i = 0; i < MAX_BULLETS; i++)
+    w.bullets[i] = Bullet{};
+  for (int i = 0; i < MAX_ENEMIES; i++)
+    w.enemies[i] = Enemy{};
+  for (int i = 0; i < MAX_BULLETS; i++)
+    w.ebullets[i] = EnemyBullet{};
+  w.ship_fx = static_cast<float>(w.screen_w) / 2.0f;
+  w.prev_ship_fx = w.ship_fx;
+  w.ship_x = static_cast<int>(std::round(w.ship_fx));
+  world_seed(w, seed);
+  w.player_score = 0;
+  w.player_lives = 3;
+  w.game_running = true;
+  w.player_hit = false;
+  w.enemy_stop_descent.store(false);
+  w.enemy_direction = 1;
+  w.enemy_tick_counter = 0;
+  w.score_last_seen = 0;
+  w.dive_cooldown = DIVE_LAUNCH_TICKS;
+  script_runner_clear(w.scripts);
+  timer_wheel_reset(w);
+  timer_schedule(w, w.score_timer, score_tick, timer_ticks(SCORE_CHECK_MS));
+  if (w.particles_enabled)
+    timer_schedule(w, w.effects_timer, visual_effects_tick, 1);
+  // Calcular que tanto pueden bajar los enemigos.
+  w.max_enemy_y = std::max(2, w.screen_h / 2 - ENEMY_H);
+}
+
+// Inicializa el estado del juego y configura la pantalla
+void init_game(GameWorld &w) {
+  int width, height;
+  getmaxyx(stdscr, height, width);
+  clear();
+  refresh();
+  init_game_state(w, width, height, static_cast<uint32_t>(std::time(nullptr)));
+  particles_clear(w);
+  // Crear buffer fuera de pantalla
+  if (backwin) {
+    delwin(backwin);
+    backwin = nullptr;
+  }
+  backwin = newwin(w.screen_h, w.screen_w, 0, 0);
+}
+
+// Genera enemigos en formación para el grupo especificado en el modo actual
+void spawn_enemies(GameWorld &w, int group_num) {
+  (void)group_num;
+  const ModeDesc &m = mode_desc(w.game_mode);
+  int group_size = m.group_size;
+  int enemies_per_row = m.enemies_per_row;
+  int rows = m.rows();
+
+  int idx = 0;
+
+  // Limpiar enemigos anteriores
+  script_runner_clear(w.scripts);
+  for (int i = 0; i < MAX_ENEMIES; i++) {
+    w.enemies[i].alive = false;
+    w.enemies[i].dive_path = -1;
+    w.enemies[i].fire_slot = -1;
+  }
+  w.fire_heap_size = 0;
+
+  Formation &f = w.formation;
+  f = Formation{};
+  f.x = 2;
+  f.y = 2;
+  for (int c = 0; c < enemies_per_row; c++)
+    f.col_dx[c] = c * static_cast<float>((w.screen_w - 4)) / enemies_per_row;
+  f.min_col = enemies_per_row;
+  for (int r = 0; r < rows && idx < group_size; r++) {
+    for (int c = 0; c < enemies_per_row && idx < group_size; c++) {
+      Enemy &e = w.enemies[idx];
+      e.alive = true;
+      e.off_x = f.col_dx[c];
+      e.off_y = static_cast<float>(r * (ENEMY_H + 1));
+      e.row = r;
+      e.col = c;
+      f.col_alive[c]++;
+      f.row_alive[r]++;
+      f.min_col = std::min(f.min_col, c);
+      f.max_col = std::max(f.max_col, c);
+      f.max_row = r;
+      idx++;
+    }
+  }
+
+  for (int i = 0; i < idx; i++)
+    fire_schedule(w, i);
+  w.enemies_in_current_group = group_size;
+}
+
+// Reinicia el grupo actual
+void reset_level(GameWorld &w) {
+  for (int i = 0; i < MAX_BULLETS; i++) {
+    w.bullets[i].active = false;
+    w.bullets[i].x = 0;
+    w.bullets[i].y = 0;
+    w.ebullets[i].active = false;
+    w.ebullets[i].x = 0;
+    w.ebullets[i].y = 0;
+  }
+  spawn_enemies(w, w.current_group);
+  w.enemy_stop_descent.store(false);
+}
+
+/**
+ * Estados guardados
+ * Imagen binaria de WorldData (solo datos planos) precedida de una cabecera
+ * con versión y tamaño. Se escribe y se carga con un único write()/read(),
+ * sin interpretar campo por campo, así que solo es compatible entre binarios
+ * de la misma versión y arquitectura.
+ */
+constexpr char SAVE_MAGIC[8] = {'G', 'L', 'G', 'S', 'A', 'V', 'E', '\0'};
+constexpr uint32_t SAVE_VERSION = 6;
+static const char *QUICKSAVE_FILENAME = "galaga_quicksave.bin";
+
+static_assert(std::is_trivially_copyable<WorldData>::value,
+              "WorldData debe poder copiarse byte a byte");
+
+struct SaveImage {
+  char magic[8];
+  uint32_t version;
+  uint32_t world_size;
+  // Estado atómico de GameWorld que también forma parte de la partida
+  uint8_t player_hit;
+  uint8_t enemy_stop_descent;
+  WorldData world;
+};
+
+// Debe llamarse con los mutex del mundo tomados (o sin hilos corriendo)
+static bool save_state(const GameWorld &w, const char *path) {
+  SaveImage img{};
+  std::memcpy(img.magic, SAVE_MAGIC, sizeof(img.magic));
+  img.version = SAVE_VERSION;
+  img.world_size = sizeof(WorldData);
+  img.player_hit = w.player_hit.load();
+  img.enemy_stop_descent = w.enemy_stop_descent.load();
+  img.world = w;
+
+  // Escribir a un temporal y renombrar para no dejar un archivo a medias
+  std::string tmp = std::string(path) + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  bool ok = write(fd, &img, sizeof(img)) == static_cast<ssize_t>(sizeof(img));
+  ok = close(fd) == 0 && ok;
+  if (ok && std::rename(tmp.c_str(), path) != 0)
+    ok = false;
+  if (!ok)
+    unlink(tmp.c_str());
+  return ok;
+}
+
+static bool load_state_image(const char *path, SaveImage &img) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  ssize_t n = read(fd, &img, sizeof(img));
+  close(fd);
+  if (n != static_cast<ssize_t>(sizeof(img)) ||
+      std::memcmp(img.magic, SAVE_MAGIC, sizeof(img.magic)) != 0 ||
+      img.version != SAVE_VERSION || img.world_size != sizeof(WorldData))
+    return false;
+  const WorldData &d = img.world;
+  return d.game_mode >= 1 && d.game_mode <= MAX_GAME_MODES &&
+         d.screen_w > 0 && d.screen_h > 0 && d.player_lives > 0;
+}
+
+static void enemy_scripts_restore(GameWorld &w); // más abajo, con los patrones
+
+// Debe llamarse con los mutex del mundo tomados (o sin hilos corriendo)
+static void apply_state(GameWorld &w, const SaveImage &img) {
+  static_cast<WorldData &>(w) = img.world;
+  enemy_scripts_restore(w);
+  w.player_hit = img.player_hit != 0;
+  w.enemy_stop_descent = img.enemy_stop_descent != 0;
+  // El parpadeo de daño vuelve a durar DAMAGE_FLASH_DURATION_MS completo
+  if (w.player_hit.load())
+    timer_schedule(w, w.flash_timer, damage_flash_end,
+                   timer_ticks(DAMAGE_FLASH_DURATION_MS));
+  else
+    timer_cancel(w, w.flash_timer);
+  timer_cancel(w, w.movement_timer);
+  w.move_left = false;
+  w.move_right = false;
+  w.want_fire = false;
+  w.held_key = 0;
+  w.input_key_us = 0;
+  w.input_applied_key_us = w.input_applied_us = 0;
+}
+
+// Aviso breve en el HUD tras guardar/cargar
+static std::atomic<const char *> state_notice{nullptr};
+static std::atomic<long long> state_notice_until_ms{0};
+constexpr int STATE_NOTICE_MS = 1500;
+
+static void show_state_notice(const char *msg) {
+  state_notice = msg;
+  state_notice_until_ms = now_ms() + STATE_NOTICE_MS;
+}
+
+// Teclas de guardado/carga rápida, llamadas desde el hilo de entrada
+static void quick_save(GameWorld &w) {
+  bool ok;
+  {
+    std::scoped_lock lock(w.game_state_mutex, w.bullet_mutex, w.enemy_mutex,
+                          w.score_mutex);
+    ok = save_state(w, QUICKSAVE_FILENAME);
+  }
+  show_state_notice(ok ? "Partida guardada" : "No se pudo guardar");
+}
+
+static void quick_load(GameWorld &w) {
+  SaveImage img;
+  if (!load_state_image(QUICKSAVE_FILENAME, img)) {
+    show_state_notice("No hay partida guardada");
+    return;
+  }
+  {
+    std::scoped_lock lock(w.game_state_mutex, w.bullet_mutex, w.enemy_mutex,
+                          w.score_mutex);
+    apply_state(w, img);
+  }
+  show_state_notice("Partida cargada");
+}
+
+/**
+ * Afinidad, prioridad y jitter de los hilos
+ * --pin-sim y --pin-render fijan los hilos de simulación y el de render
+ * (el principal) a un conjunto de CPUs; --sched pide SCHED_FIFO o SCHED_RR
+ * y --nice un nivel de nice. Si el sistema no lo permite (típicamente EPERM
+ * sin CAP_SYS_NICE) el juego sigue con la política normal y lo informa al
+ * salir.
+ * Los hilos periódicos esperan con un TickPacer: duermen hasta el próximo
+ * inicio de tick previsto (sleep_until, sin acumular el tiempo de trabajo) y
+ * registran cuánto tarde se despertaron en un histograma global.
+ */
+static cpu_set_t opt_sim_cpus, opt_render_cpus;
+static bool opt_pin_sim = false, opt_pin_render = false;
+static int opt_sched_policy = SCHED_OTHER;
+static int opt_sched_prio = 0;
+static bool opt_nice_given = false;
+static int opt_nice = 0;
+static bool opt_jitter_report = false;
+
+constexpr int SCHED_DEFAULT_RT_PRIO = 10;
+
+// Primer error de cada tipo, para informarlo después de endwin()
+struct SchedStatus {
+  std::atomic<int> affinity_err{0};
+  std::atomic<int> sched_err{0};
+  std::atomic<int> nice_err{0};
+};
+static SchedStatus sched_status;
+
+// Lista de CPUs "0,2-3"; false si es inválida
+static bool parse_cpu_list(const char *s, cpu_set_t &set) {
+  CPU_ZERO(&set);
+  while (*s) {
+    char *end;
+    long a = std::strtol(s, &end, 10), b = a;
+    if (end == s || a < 0 || a >= CPU_SETSIZE)
+      return false;
+    s = end;
+    if (*s == '-') {
+      b = std::strtol(s + 1, &end, 10);
+      if (end == s + 1 || b < a || b >= CPU_SETSIZE)
+        return false;
+      s = end;
+    }
+    for (long c = a; c <= b; c++)
+      CPU_SET(c, &set);
+    if (*s == ',')
+      s++;
+    else if (*s)
+      return false;
+  }
+  return CPU_COUNT(&set) > 0;
+}
+
+static void record_sched_error(std::atomic<int> &slot, int err) {
+  int expected = 0;
+  slot.compare_exchange_strong(expected, err);
+}
+
+// Aplica afinidad y prioridad al hilo que la llama
+static void apply_thread_policy(bool pin, const cpu_set_t &cpus) {
+  if (pin) {
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err)
+      record_sched_error(sched_status.affinity_err, err);
+  }
+  bool realtime = false;
+  if (opt_sched_policy != SCHED_OTHER) {
+    sched_param param{};
+    param.sched_priority = opt_sched_prio;
+    int err = pthread_setschedparam(pthread_self(), opt_sched_policy, &param);
+    if (err)
+      record_sched_error(sched_status.sched_err, err);
+    realtime = err == 0;
+  }
+  // nice solo afecta a SCHED_OTHER; también es el respaldo si se negó el
+  // tiempo real. En Linux es por hilo.
+  if (opt_nice_given && !realtime &&
+      setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                  opt_nice) != 0)
+    record_sched_error(sched_status.nice_err, errno);
+}
+
+// Crea un hilo de simulación con la afinidad y prioridad pedidas
+template <typename F, typename... Args>
+static std::thread sim_thread(F fn, Args... args) {
+  return std::thread([=]() {
+    apply_thread_policy(opt_pin_sim, opt_sim_cpus);
+    fn(args...);
+  });
+}
+
+constexpr int JITTER_BUCKETS = 9;
+// Límite superior de cada cubeta en microsegundos; la última no tiene
+constexpr int64_t JITTER_BOUNDS_US[JITTER_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2000, 5000, 10000};
+
+struct JitterHistogram {
+  std::atomic<long long> buckets[JITTER_BUCKETS] = {};
+  std::atomic<long long> total_us{0};
+  std::atomic<long long> max_us{0};
+  std::atomic<long long> late_ticks{0}; // se saltearon ticks enteros
+};
+static JitterHistogram jitter;
+
+static void jitter_record(int64_t us) {
+  int b = 0;
+  while (b < JITTER_BUCKETS - 1 && us >= JITTER_BOUNDS_US[b])
+    b++;
+  jitter.buckets[b].fetch_add(1, std::memory_order_relaxed);
+  jitter.total_us.fetch_add(us, std::memory_order_relaxed);
+  long long prev = jitter.max_us.load(std::memory_order_relaxed);
+  while (us > prev && !jitter.max_us.compare_exchange_weak(prev, us))
+    ;
+}
+
+// Espera periódica con inicio de tick fijo
+struct TickPacer {
+  std::chrono::steady_clock::time_point next;
+  std::chrono::microseconds period;
+  PauseGate *gate;
+  explicit TickPacer(int ms, PauseGate *gate = nullptr)
+      : next(std::chrono::steady_clock::now()), period(ms * 1000),
+        gate(gate) {
+    next += period;
+  }
+  void wait() {
+    std::this_thread::sleep_until(next);
+    // Tras una pausa se sigue desde ahora, sin contarla como jitter
+    if (gate && pause_park(*gate)) {
+      next = std::chrono::steady_clock::now() + period;
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    jitter_record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - next)
+            .count());
+    next += period;
+    // Si el hilo estuvo detenido más de un tick no se intenta recuperar
+    if (now >= next) {
+      jitter.late_ticks.fetch_add(1, std::memory_order_relaxed);
+      next = now + period;
+    }
+  }
+};
+
+// Valor aproximado del percentil p (0-1): el límite de su cubeta
+static const char *jitter_percentile(double p, long long n, char *buf,
+                                     size_t len) {
+  long long target = static_cast<long long>(p * n), seen = 0;
+  for (int b = 0; b < JITTER_BUCKETS; b++) {
+    seen += jitter.buckets[b].load();
+    if (seen > target) {
+      if (b == JITTER_BUCKETS - 1)
+        std::snprintf(buf, len, ">=%lld us",
+                      static_cast<long long>(JITTER_BOUNDS_US[b - 1]));
+      else
+        std::snprintf(buf, len, "<%lld us",
+                      static_cast<long long>(JITTER_BOUNDS_US[b]));
+      return buf;
+    }
+  }
+  return "-";
+}
+
+static void sched_print_report(FILE *out) {
+  auto status = [](int err) { return err ? std::strerror(err) : "ok"; };
+  if (opt_pin_sim || opt_pin_render)
+    std::fprintf(out, "Afinidad: %s\n",
+                 status(sched_status.affinity_err.load()));
+  if (opt_sched_policy != SCHED_OTHER)
+    std::fprintf(out, "%s prioridad %d: %s%s\n",
+                 opt_sched_policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR",
+                 opt_sched_prio, status(sched_status.sched_err.load()),
+                 sched_status.sched_err.load() ? " (se siguió con SCHED_OTHER)"
+                                               : "");
+  if (opt_nice_given && opt_sched_policy != SCHED_OTHER &&
+      !sched_status.sched_err.load())
+    std::fprintf(out, "nice %d: no se usa con tiempo real\n", opt_nice);
+  else if (opt_nice_given)
+    std::fprintf(out, "nice %d: %s\n", opt_nice,
+                 status(sched_status.nice_err.load()));
+
+  long long n = 0;
+  for (auto &b : jitter.buckets)
+    n += b.load();
+  if (n == 0)
+    return;
+  char p50[24], p95[24], p99[24];
+  std::fprintf(out,
+               "Jitter al iniciar cada tick (real - previsto): %lld ticks, "
+               "promedio %.0f us, máx %lld us, %lld atrasados más de un "
+               "tick\n",
+               n, static_cast<double>(jitter.total_us.load()) / n,
+               jitter.max_us.load(), jitter.late_ticks.load());
+  std::fprintf(out, "  p50 %s, p95 %s, p99 %s\n",
+               jitter_percentile(0.50, n, p50, sizeof(p50)),
+               jitter_percentile(0.95, n, p95, sizeof(p95)),
+               jitter_percentile(0.99, n, p99, sizeof(p99)));
+  for (int b = 0; b < JITTER_BUCKETS; b++) {
+    long long c = jitter.buckets[b].load();
+    char label[24];
+    if (b == JITTER_BUCKETS - 1)
+      std::snprintf(label, sizeof(label), ">=%lld",
+                    static_cast<long long>(JITTER_BOUNDS_US[b - 1]));
+    else
+      std::snprintf(label, sizeof(label), "<%lld",
+                    static_cast<long long>(JITTER_BOUNDS_US[b]));
+    int bar = static_cast<int>(40 * c / n);
+    std::fprintf(out, "  %8s us %8lld %5.1f%% %s\n", label, c, 100.0 * c / n,
+                 std::string(bar, '#').c_str());
+  }
+}
+
+/**
+ * Intercepción entre balas
+ * Una bala del jugador y una enemiga en la misma columna se anulan si se
+ * cruzaron o quedaron a menos de media fila. Cada lista la mueve su propio
+ * hilo, así que la prueba se hace en el paso que mueve balas, bajo
+ * bullet_mutex, contra la posición actual de las del otro lado: los pasos se
+ * serializan y cada cruce lo ve exactamente el movimiento que lo produjo. En
+ * vez de probar todos los pares, ambas listas se ordenan por columna y una
+ * pasada de mezcla solo compara balas de la misma columna: O(n log n) en
+ * lugar de O(n·m).
+ */
+struct SweepKey {
+  int col;
+  int idx;
+};
+
+static inline bool sweep_key_less(const SweepKey &a, const SweepKey &b) {
+  return a.col < b.col || (a.col == b.col && a.idx < b.idx);
+}
+
+// La bala del jugador empezó el paso debajo de la enemiga (o a la par) y lo
+// terminó arriba (o a la par); ambas se movieron en el mismo paso
+static inline bool bullets_cross(const Bullet &pb, const EnemyBullet &eb) {
+  return pb.prev_y - eb.prev_y >= -0.5f && pb.y - eb.y <= 0.5f;
+}
+
+// Igual, pero solo se movió la bala del jugador
+static inline bool player_bullet_crossed(const Bullet &pb,
+                                         const EnemyBullet &eb) {
+  return pb.prev_y - eb.y >= -0.5f && pb.y - eb.y <= 0.5f;
+}
+
+// Igual, pero solo se movió la bala enemiga
+static inline bool enemy_bullet_crossed(const Bullet &pb,
+                                        const EnemyBullet &eb) {
+  return pb.y - eb.prev_y >= -0.5f && pb.y - eb.y <= 0.5f;
+}
+
+/**
+ * Desactiva los pares de balas para los que cross(bala, enemiga) es cierto y
+ * llama on_hit(bala, enemiga) por cada uno. pk y ek son espacio de trabajo para np y ne claves. Dentro
+ * de una columna los pares se prueban en orden de índice, igual que el
+ * doble bucle directo.
+ */
+template <typename Cross, typename OnHit>
+static int intercept_sweep(Bullet *pb, int np, EnemyBullet *eb, int ne,
+                           SweepKey *pk, SweepKey *ek, Cross cross,
+                           OnHit on_hit) {
+  int n = 0, m = 0;
+  for (int i = 0; i < np; i++)
+    if (pb[i].active)
+      pk[n++] = {static_cast<int>(std::round(pb[i].x)), i};
+  for (int i = 0; i < ne; i++)
+    if (eb[i].active)
+      ek[m++] = {static_cast<int>(std::round(eb[i].x)), i};
+  if (n == 0 || m == 0)
+    return 0;
+  std::sort(pk, pk + n, sweep_key_less);
+  std::sort(ek, ek + m, sweep_key_less);
+
+  int hits = 0, i = 0, j = 0;
+  while (i < n && j < m) {
+    if (pk[i].col < ek[j].col) {
+      i++;
+    } else if (pk[i].col > ek[j].col) {
+      j++;
+    } else {
+      int col = pk[i].col, i_end = i, j_end = j;
+      while (i_end < n && pk[i_end].col == col)
+        i_end++;
+      while (j_end < m && ek[j_end].col == col)
+        j_end++;
+      for (int a = i; a < i_end; a++)
+        for (int b = j; b < j_end; b++) {
+          Bullet &p = pb[pk[a].idx];
+          EnemyBullet &e = eb[ek[b].idx];
+          if (p.active && e.active && cross(p, e)) {
+            p.active = e.active = false;
+            on_hit(p, e);
+            hits++;
+          }
+        }
+      i = i_end;
+      j = j_end;
+    }
+  }
+  return hits;
+}
+
+// Debe llamarse con bullet_mutex tomado, justo después de mover un lado
+template <typename Cross>
+static void bullet_intercept_step(GameWorld &w, Cross cross) {
+  SweepKey pk[MAX_BULLETS], ek[MAX_BULLETS];
+  intercept_sweep(w.bullets, MAX_BULLETS, w.ebullets, MAX_BULLETS, pk, ek,
+                  cross, [&w](const Bullet &p, const EnemyBullet &) {
+                    spawn_particles(w, p.x, p.y, INTERCEPT_PARTICLES, ".'",
+                                    3);
+                  });
+}
+
+/**
+ * Hilo 1: Manejo de balas del jugador
+ * Actualiza la posición de las balas del jugador y elimina las que salen de
+ * pantalla
+ */
+void player_bullet_step(GameWorld &w) {
+  TraceSpan span("player_bullet_step", "sistema");
+  TracedLock lock(w.bullet_mutex, "bullet_mutex");
+  for (int i = 0; i < MAX_BULLETS; i++) {
+    if (w.bullets[i].active) {
+      w.bullets[i].prev_y = w.bullets[i].y;
+      w.bullets[i].y -= PLAYER_BULLET_SPEED * tick_scale;
+      if (w.bullets[i].y < 1)
+        w.bullets[i].active = false;
+    }
+  }
+  bullet_intercept_step(w, player_bullet_crossed);
+}
+
+void *player_bullet_manager_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("balas_jugador");
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    player_bullet_step(w);
+    w.bullet_tick_ms = now_ms();
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Hilo 2: Manejo de balas enemigas
+ * Actualiza la posición de las balas enemigas y elimina las que salen de
+ * pantalla
+ */
+void enemy_bullet_step(GameWorld &w) {
+  TraceSpan span("enemy_bullet_step", "sistema");
+  TracedLock lock(w.bullet_mutex, "bullet_mutex");
+  for (int b = 0; b < MAX_BULLETS; b++) {
+    if (w.ebullets[b].active) {
+      w.ebullets[b].prev_y = w.ebullets[b].y;
+      w.ebullets[b].y += ENEMY_BULLET_SPEED * tick_scale;
+      if (w.ebullets[b].y >= w.screen_h)
+        w.ebullets[b].active = false;
+    }
+  }
+  bullet_intercept_step(w, enemy_bullet_crossed);
+}
+
+void *enemy_bullet_manager_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("balas_enemigas");
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    enemy_bullet_step(w);
+    w.ebullet_tick_ms = now_ms();
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Hilo 3: Detector de colisiones entre balas del jugador y enemigos
+ * Detecta cuando las balas del jugador atinan
+ */
+template <int Mode> void player_bullet_collision_step_mode(GameWorld &w) {
+  constexpr const ModeDesc &M = MODES[Mode];
+  const SpriteMask &mask = enemy_masks[M.art_level];
+  TracedLock lock1(w.bullet_mutex, "bullet_mutex");
+  TracedLock lock2(w.enemy_mutex, "enemy_mutex");
+
+  for (int i = 0; i < MAX_BULLETS; i++) {
+    if (w.bullets[i].active) {
+      for (int e = 0; e < M.group_size; e++) {
+        if (w.enemies[e].alive) {
+          int bx = static_cast<int>(std::round(w.bullets[i].x));
+          int by = static_cast<int>(std::round(w.bullets[i].y));
+          int ex = static_cast<int>(std::round(enemy_x(w, w.enemies[e])));
+          int ey = static_cast<int>(std::round(enemy_y(w, w.enemies[e])));
+
+          if (sprite_hit(mask, enemy_draw_x(ex, w.screen_w), ey, bx, by)) {
+            formation_kill(w, w.enemies[e]);
+            w.bullets[i].active = false;
+            spawn_particles(w, ex + ENEMY_W / 2.0f, ey + ENEMY_H / 2.0f,
+                            EXPLOSION_PARTICLES, "*+.'", 3);
+            {
+              TracedLock score_lock(w.score_mutex, "score_mutex");
+              w.player_score += 10;
+              w.enemies_destroyed++;
+              w.enemies_in_current_group--;
+            }
+            telemetry_event(w, TEL_SRC_COLLISION, TEL_KILL,
+                            w.enemies[e].row, w.player_score);
+          }
+        }
+      }
+    }
+  }
+}
+
+void player_bullet_collision_step(GameWorld &w) {
+  TraceSpan span("player_bullet_collision_step", "sistema");
+  static constexpr auto table = mode_table([](auto m) -> SystemFn {
+    return &player_bullet_collision_step_mode<decltype(m)::value>;
+  });
+  table[w.game_mode - 1](w);
+}
+
+void *player_bullet_collision_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("colision_jugador");
+  TickPacer pacer(opt_tick_ms / 2, &w.pause);
+  while (w.game_running.load()) {
+    player_bullet_collision_step(w);
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Ataques en picada
+ * Las trayectorias son curvas de Bézier cúbicas que se precalculan al inicio
+ * en tablas de DIVE_PATH_STEPS puntos equiespaciados por longitud de arco.
+ * Avanzar un enemigo en picada es leer la tabla en su índice: dx en columnas
+ * relativo a su lugar en la formación y dy como fracción de la distancia
+ * hasta cerca de la nave. Todas las curvas terminan en (0, 0), así que el
+ * enemigo vuelve a su lugar aunque la formación se haya movido.
+ */
+constexpr int DIVE_PATH_COUNT = 2;
+constexpr int DIVE_PATH_STEPS = 128; // ~3.8 s con el tick por defecto
+constexpr int DIVE_SEGMENTS = 3;
+// Filas que deja libre el punto más bajo de la picada sobre la nave
+constexpr int DIVE_CLEARANCE = 3;
+
+struct DivePoint {
+  float dx, dy;
+};
+
+// Puntos de control (dx en columnas, dy normalizado) de cada segmento
+static const DivePoint DIVE_CONTROL[DIVE_PATH_COUNT][DIVE_SEGMENTS][4] = {
+    // Se abre hacia afuera, cruza en picada y vuelve por el otro lado
+    {{{0, 0}, {4, -0.15f}, {8, 0.1f}, {6, 0.4f}},
+     {{6, 0.4f}, {4, 0.8f}, {-6, 1.0f}, {-10, 0.8f}},
+     {{-10, 0.8f}, {-14, 0.5f}, {-4, 0.1f}, {0, 0}}},
+    // Rizo hacia adentro y barrido amplio
+    {{{0, 0}, {-3, -0.2f}, {-8, 0.0f}, {-6, 0.3f}},
+     {{-6, 0.3f}, {-2, 0.7f}, {10, 1.0f}, {12, 0.6f}},
+     {{12, 0.6f}, {14, 0.2f}, {4, -0.1f}, {0, 0}}},
+};
+
+struct DivePath {
+  float dx[DIVE_PATH_STEPS];
+  float dy[DIVE_PATH_STEPS];
+};
+static DivePath dive_paths[DIVE_PATH_COUNT];
+
+// Evalúa la curva en u ∈ [0, 1] (solo para armar las tablas y el benchmark)
+static DivePoint dive_path_eval(int path, float u) {
+  float s = std::min(u, 1.0f) * DIVE_SEGMENTS;
+  int seg = std::min(static_cast<int>(s), DIVE_SEGMENTS - 1);
+  float t = s - seg;
+  float it = 1.0f - t;
+  const DivePoint *c = DIVE_CONTROL[path][seg];
+  float b0 = it * it * it, b1 = 3 * it * it * t, b2 = 3 * it * t * t,
+        b3 = t * t * t;
+  return {b0 * c[0].dx + b1 * c[1].dx + b2 * c[2].dx + b3 * c[3].dx,
+          b0 * c[0].dy + b1 * c[1].dy + b2 * c[2].dy + b3 * c[3].dy};
+}
+
+static void build_dive_paths() {
+  // Alto nominal en columnas para medir la longitud de arco
+  constexpr float NOMINAL_SPAN = 12.0f;
+  constexpr int FINE = 2048;
+  static float arc[FINE + 1];
+  for (int p = 0; p < DIVE_PATH_COUNT; p++) {
+    arc[0] = 0;
+    DivePoint prev = dive_path_eval(p, 0);
+    for (int i = 1; i <= FINE; i++) {
+      DivePoint cur = dive_path_eval(p, static_cast<float>(i) / FINE);
+      arc[i] = arc[i - 1] + std::hypot(cur.dx - prev.dx,
+                                       (cur.dy - prev.dy) * NOMINAL_SPAN);
+      prev = cur;
+    }
+    int j = 0;
+    for (int k = 0; k < DIVE_PATH_STEPS; k++) {
+      float target = arc[FINE] * k / (DIVE_PATH_STEPS - 1);
+      while (j < FINE && arc[j + 1] < target)
+        j++;
+      float seg = arc[j + 1] - arc[j];
+      float f = seg > 0 ? (target - arc[j]) / seg : 0;
+      DivePoint pt = dive_path_eval(p, (j + f) / FINE);
+      dive_paths[p].dx[k] = pt.dx;
+      dive_paths[p].dy[k] = pt.dy;
+    }
+  }
+}
+
+// Avanza un enemigo en picada un tick; devuelve false al volver a su lugar
+static inline bool advance_diver(Enemy &e, float home_x, float home_y,
+                                 float span, float max_x) {
+  e.dive_t += tick_scale;
+  int i = static_cast<int>(e.dive_t);
+  if (i >= DIVE_PATH_STEPS)
+    return false;
+  const DivePath &p = dive_paths[e.dive_path];
+  e.x = std::min(max_x, std::max(1.0f, home_x + e.dive_dir * p.dx[i]));
+  e.y = std::max(1.0f, home_y + p.dy[i] * span);
+  return true;
+}
+
+// Dispara una bala desde el enemigo e; devuelve false si no hay balas libres.
+// Debe llamarse con bullet_mutex y enemy_mutex tomados.
+static bool enemy_fire(GameWorld &w, int e) {
+  for (int b = 0; b < MAX_BULLETS; b++) {
+    if (!w.ebullets[b].active) {
+      w.ebullets[b].active = true;
+      w.ebullets[b].x = enemy_x(w, w.enemies[e]) + ENEMY_W / 2.0f;
+      w.ebullets[b].y = enemy_y(w, w.enemies[e]) + ENEMY_H;
+      w.ebullets[b].prev_y = w.ebullets[b].y;
+      if (w.telemetry_enabled)
+        telemetry_event(w, TEL_SRC_ENEMY_SHOOT, TEL_ENEMY_SHOT,
+                        count_active(w.ebullets));
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Patrones de ataque
+ * Cada salida de la formación es un guion (ver ScriptRunner): las picadas
+ * siguen una de las trayectorias precalculadas; el barrido avisa temblando
+ * en su lugar, baja hacia la columna de la nave, la cruza de lado a lado
+ * soltando una ráfaga y vuelve. Todos terminan en su lugar de la formación
+ * y vuelven a disparar con la probabilidad normal. Las duraciones están en
+ * ticks de UPDATE_INTERVAL_MS y se escalan con --tick-ms.
+ */
+constexpr int STRAFE_PATH = DIVE_PATH_COUNT; // dive_path del barrido
+constexpr int ATTACK_PATTERNS = DIVE_PATH_COUNT + 1;
+constexpr int STRAFE_WARN_TICKS = 12;
+constexpr int STRAFE_DESCEND_TICKS = 30;
+constexpr int STRAFE_SWEEP_TICKS = 45;
+constexpr float STRAFE_SWEEP_SPEED = 0.6f; // columnas por tick
+constexpr float STRAFE_DEPTH = 0.6f;       // fracción de la picada completa
+constexpr int STRAFE_BURST_SHOTS = 3;
+constexpr int STRAFE_BURST_GAP_TICKS = 3;
+constexpr float STRAFE_AIM_COLS = 3.0f; // distancia a la nave para la ráfaga
+constexpr int RETURN_TICKS = 30;
+
+static inline int script_ticks(int nominal) {
+  return std::max(1, static_cast<int>(std::lround(nominal / tick_scale)));
+}
+
+// Altura útil de una picada desde y hasta cerca de la nave
+static inline float dive_span(const WorldData &w, float home_y) {
+  return std::max(0.0f, w.ship_y - DIVE_CLEARANCE - ENEMY_H - home_y);
+}
+
+// Punto a fracción u del regreso desde (from_x, from_y) a su lugar, que
+// puede haberse movido
+static inline void sortie_return_at(const WorldData &w, Enemy &en,
+                                    float from_x, float from_y, float u) {
+  en.x = from_x + (enemy_home_x(w, en) - from_x) * u;
+  en.y = from_y + (enemy_home_y(w, en) - from_y) * u;
+}
+
+// Fin de cualquier patrón: sigue a la formación y dispara como ella
+static void sortie_end(GameWorld &w, int e) {
+  w.enemies[e].dive_path = -1;
+  fire_schedule(w, e);
+}
+
+static EnemyScript dive_script(GameWorld &w, int e) {
+  Enemy &en = w.enemies[e];
+  float max_x = static_cast<float>(w.screen_w - 2);
+  while (true) {
+    float home_x = enemy_home_x(w, en), home_y = enemy_home_y(w, en);
+    if (!advance_diver(en, home_x, home_y, dive_span(w, home_y), max_x))
+      break;
+    co_await script_sleep(1);
+  }
+  sortie_end(w, e);
+}
+
+// Vuelve en línea recta desde donde esté hasta su lugar
+static EnemyScript return_script(GameWorld &w, int e) {
+  Enemy &en = w.enemies[e];
+  float from_x = en.x, from_y = en.y;
+  int n = script_ticks(RETURN_TICKS);
+  for (int t = 1; t <= n; t++) {
+    sortie_return_at(w, en, from_x, from_y, static_cast<float>(t) / n);
+    co_await script_sleep(1);
+  }
+  sortie_end(w, e);
+}
+
+static EnemyScript strafe_script(GameWorld &w, int e) {
+  Enemy &en = w.enemies[e];
+  float max_x = static_cast<float>(w.screen_w - 2);
+
+  // Aviso: tiembla en su lugar
+  int n = script_ticks(STRAFE_WARN_TICKS);
+  for (int t = 0; t < n; t++) {
+    en.x = enemy_home_x(w, en) + (t / script_ticks(2) % 2 ? 1 : -1);
+    en.y = enemy_home_y(w, en);
+    co_await script_sleep(1);
+  }
+
+  // Baja hacia la columna donde está la nave ahora
+  float from_x = en.x, from_y = en.y;
+  float to_x =
+      std::min(max_x - ENEMY_W, std::max(1.0f, w.ship_fx - ENEMY_W / 2.0f));
+  float to_y = from_y + dive_span(w, from_y) * STRAFE_DEPTH;
+  n = script_ticks(STRAFE_DESCEND_TICKS);
+  for (int t = 1; t <= n; t++) {
+    float u = static_cast<float>(t) / n;
+    float ease = u * u * (3 - 2 * u);
+    en.x = from_x + (to_x - from_x) * ease;
+    en.y = from_y + (to_y - from_y) * ease;
+    co_await script_sleep(1);
+  }
+
+  // Barrido hacia el centro; la ráfaga sale al pasar cerca de la nave
+  float vx = (en.x > w.screen_w / 2 ? -1 : 1) * STRAFE_SWEEP_SPEED *
+             tick_scale;
+  int shots = STRAFE_BURST_SHOTS;
+  int cooldown = 0;
+  n = script_ticks(STRAFE_SWEEP_TICKS);
+  for (int t = 0; t < n; t++) {
+    en.x += vx;
+    if (en.x < 1 || en.x > max_x - ENEMY_W) {
+      vx = -vx;
+      en.x = std::min(max_x - ENEMY_W, std::max(1.0f, en.x));
+    }
+    if (cooldown > 0) {
+      cooldown--;
+    } else if (shots > 0 &&
+               std::fabs(en.x + ENEMY_W / 2.0f - w.ship_fx) <=
+                   STRAFE_AIM_COLS) {
+      enemy_fire(w, e);
+      shots--;
+      cooldown = script_ticks(STRAFE_BURST_GAP_TICKS);
+    }
+    co_await script_sleep(1);
+  }
+
+  from_x = en.x;
+  from_y = en.y;
+  n = script_ticks(RETURN_TICKS);
+  for (int t = 1; t <= n; t++) {
+    sortie_return_at(w, en, from_x, from_y, static_cast<float>(t) / n);
+    co_await script_sleep(1);
+  }
+  sortie_end(w, e);
+}
+
+// Saca al enemigo e de la formación con el patrón dado
+static void sortie_start(GameWorld &w, int e, int pattern) {
+  Enemy &en = w.enemies[e];
+  en.dive_path = pattern;
+  en.dive_t = 0;
+  en.x = enemy_home_x(w, en);
+  en.y = enemy_home_y(w, en);
+  // Los de la mitad derecha salen en espejo, hacia el centro
+  en.dive_dir = en.x > w.screen_w / 2 ? -1 : 1;
+  fire_schedule(w, e);
+  script_start(w.scripts,
+               pattern == STRAFE_PATH ? strafe_script(w, e) : dive_script(w, e),
+               &en.alive);
+}
+
+// Tras cargar un estado guardado los guiones no existen: los que estaban
+// fuera de la formación vuelven a su lugar
+static void enemy_scripts_restore(GameWorld &w) {
+  script_runner_clear(w.scripts);
+  for (int e = 0; e < MAX_ENEMIES; e++) {
+    Enemy &en = w.enemies[e];
+    if (en.alive && en.dive_path >= 0)
+      script_start(w.scripts, return_script(w, e), &en.alive);
+  }
+}
+
+// Debe llamarse con enemy_mutex tomado
+template <int Mode> static void enemy_dive_step(GameWorld &w) {
+  constexpr const ModeDesc &M = MODES[Mode];
+  script_runner_step(w.scripts);
+
+  w.dive_cooldown -= tick_scale;
+  if (w.dive_cooldown > 0 || w.scripts.count >= M.max_divers)
+    return;
+  int candidates = 0;
+  for (int e = 0; e < M.group_size; e++)
+    if (w.enemies[e].alive && w.enemies[e].dive_path < 0)
+      candidates++;
+  if (candidates == 0)
+    return;
+  int pick = world_rand(w) % candidates;
+  for (int e = 0; e < M.group_size; e++) {
+    Enemy &en = w.enemies[e];
+    if (!en.alive || en.dive_path >= 0 || pick-- > 0)
+      continue;
+    sortie_start(w, e, world_rand(w) % ATTACK_PATTERNS);
+    break;
+  }
+  w.dive_cooldown = DIVE_LAUNCH_TICKS / 2 + world_rand(w) % DIVE_LAUNCH_TICKS;
+}
+
+/**
+ * Hilo 4: Controlador de movimiento de enemigos
+ * Maneja el movimiento horizontal y vertical de los enemigos
+ */
+template <int Mode> void enemy_movement_step_mode(GameWorld &w) {
+  // Los guiones pueden disparar (enemy_fire)
+  TracedLock bullet_lock(w.bullet_mutex, "bullet_mutex");
+  TracedLock lock(w.enemy_mutex, "enemy_mutex");
+  enemy_dive_step<Mode>(w);
+  if (w.enemy_tick_counter++ % enemy_movement_interval_ticks != 0)
+    return;
+
+  // Se mueve el origen de la formación; los que están en picada siguen su
+  // trayectoria relativa a su lugar.
+  Formation &f = w.formation;
+  if (f.min_col > f.max_col)
+    return; // no quedan vivos
+  int next_left = f.x + f.col_dx[f.min_col] + w.enemy_direction;
+  int next_right = f.x + f.col_dx[f.max_col] + w.enemy_direction;
+  if (next_left < 1 || next_right > w.screen_w - 2) {
+    w.enemy_direction = -w.enemy_direction;
+    if (!w.enemy_stop_descent.load()) {
+      float lowest_enemy_y = f.y + f.max_row * (ENEMY_H + 1);
+      if (lowest_enemy_y + ENEMY_H + ENEMY_H >
+          static_cast<float>(w.max_enemy_y))
+        w.enemy_stop_descent.store(true);
+      else
+        f.y += ENEMY_H;
+    }
+  } else {
+    f.x += w.enemy_direction;
+  }
+}
+
+void enemy_movement_step(GameWorld &w) {
+  TraceSpan span("enemy_movement_step", "sistema");
+  static constexpr auto table = mode_table([](auto m) -> SystemFn {
+    return &enemy_movement_step_mode<decltype(m)::value>;
+  });
+  table[w.game_mode - 1](w);
+}
+
+void *enemy_movement_controller_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("movimiento_enemigos");
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    enemy_movement_step(w);
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Hilo 5: Controlador de disparos enemigos
+ * Maneja los disparos aleatorios por parte de los enemigos: disparan los que
+ * tenían programada esta pasada y se les sortea el siguiente disparo. Los que
+ * están en picada disparan más seguido.
+ */
+void enemy_shooting_step(GameWorld &w) {
+  TraceSpan span("enemy_shooting_step", "sistema");
+  TracedLock bullet_lock(w.bullet_mutex, "bullet_mutex");
+  TracedLock lock(w.enemy_mutex, "enemy_mutex");
+  w.shoot_pass++;
+  while (w.fire_heap_size > 0 &&
+         w.enemies[w.fire_heap[0]].next_shot <= w.shoot_pass) {
+    int e = w.fire_heap[0];
+    enemy_fire(w, e);
+    fire_schedule(w, e);
+  }
+}
+
+void *enemy_shooting_controller_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("disparos_enemigos");
+  TickPacer pacer(UPDATE_INTERVAL_MS * 2, &w.pause);
+  while (w.game_running.load()) {
+    enemy_shooting_step(w);
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Hilo 6: Detector de colisiones entre balas enemigas y jugador
+ * Detecta cuando las balas enemigas atinan al jugador y aplica efecto visual
+ * de daño
+ */
+void enemy_bullet_collision_step(GameWorld &w) {
+  TraceSpan span("enemy_bullet_collision_step", "sistema");
+  TracedLock bullet_lock(w.bullet_mutex, "bullet_mutex");
+  for (int b = 0; b < MAX_BULLETS; b++) {
+    if (w.ebullets[b].active) {
+      if (static_cast<int>(w.ebullets[b].y) >= w.ship_y) {
+        int bullet_x = static_cast<int>(std::round(w.ebullets[b].x));
+        int bullet_y = static_cast<int>(std::round(w.ebullets[b].y));
+        int ship_left = ship_draw_x(w.ship_x, w.screen_w);
+
+        if (sprite_hit(ship_mask, ship_left, w.ship_y, bullet_x, bullet_y)) {
+          w.ebullets[b].active = false;
+          {
+            TracedLock lock(w.game_state_mutex, "game_state_mutex");
+            w.player_lives -= 1;
+            w.player_hit = true;
+            telemetry_event(w, TEL_SRC_ENEMY_COLLISION, TEL_DAMAGE,
+                            w.player_lives);
+            timer_schedule(w, w.flash_timer, damage_flash_end,
+                           timer_ticks(DAMAGE_FLASH_DURATION_MS));
+            spawn_particles(w, static_cast<float>(w.ship_x),
+                            static_cast<float>(w.ship_y), HIT_PARTICLES,
+                            "x.,", 2);
+            timer_schedule(w, w.state_timer, game_state_check, 1);
+          }
+        } else if (bullet_y >= w.screen_h) {
+          w.ebullets[b].active = false;
         }
       }
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
   }
-  return nullptr;
+}
+
+void *enemy_bullet_collision_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("colision_enemigas");
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    enemy_bullet_collision_step(w);
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Hilo 7: Verificador de completación de grupos
+ * Verifica si todos los enemigos del grupo han sido eliminados y maneja el
+ * progreso del juego
+ */
+template <int Mode> void level_completion_step_mode(GameWorld &w) {
+  constexpr const ModeDesc &M = MODES[Mode];
+  // reset_level() limpia también las balas
+  TracedLock bullet_lock(w.bullet_mutex, "bullet_mutex");
+  TracedLock lock(w.enemy_mutex, "enemy_mutex");
+  bool enemies_remaining = w.formation.min_col <= w.formation.max_col;
+
+  if (!enemies_remaining && w.enemies_in_current_group == 0) {
+    {
+      TracedLock lock(w.game_state_mutex, "game_state_mutex");
+      telemetry_event(w, TEL_SRC_LEVEL, TEL_GROUP_CLEAR);
+      w.current_group++;
+
+      // Verificar si el juego está completado
+      if (w.enemies_destroyed >= M.total_enemies()) {
+        w.game_completed = true;
+        w.game_running = false;
+      } else if (w.current_group >= GROUPS_PER_MODE) {
+        // Si completamos todos los grupos pero no todos los enemigos
+        w.current_group = 0; // Reiniciar grupos si es necesario
+      }
+
+      w.cv_level_complete.notify_all();
+    }
+
+    if (w.game_running.load()) {
+      reset_level(w);
+      telemetry_event(w, TEL_SRC_LEVEL, TEL_GROUP_START);
+    }
+  }
+}
+
+void level_completion_step(GameWorld &w) {
+  TraceSpan span("level_completion_step", "sistema");
+  static constexpr auto table = mode_table([](auto m) -> SystemFn {
+    return &level_completion_step_mode<decltype(m)::value>;
+  });
+  table[w.game_mode - 1](w);
+}
+
+void *level_completion_checker_thread(void *arg) {
+  GameWorld &w = *static_cast<GameWorld *>(arg);
+  TraceThread trace_thread("grupos");
+  TickPacer pacer(UPDATE_INTERVAL_MS * 3, &w.pause);
+  while (w.game_running.load()) {
+    level_completion_step(w);
+    pacer.wait();
+  }
+  return nullptr;
+}
+
+/**
+ * Cuadro de celdas (carácter + par de color) donde se compone cada cuadro
+ * antes de enviarlo al backend de salida. Se reserva una sola vez.
+ */
+constexpr int MAX_FRAME_W = 512;
+constexpr int MAX_FRAME_H = 256;
+
+struct Cell {
+  char ch = ' ';
+  unsigned char color = 0; // par de color de ncurses, 0 = sin color
+};
+
+struct Frame {
+  int w = 0, h = 0;
+  Cell cells[MAX_FRAME_H * MAX_FRAME_W];
+};
+
+static Frame frame_cur;
+static Frame frame_prev;
+
+static void frame_begin(Frame &f, int w, int h) {
+  f.w = std::min(w, MAX_FRAME_W);
+  f.h = std::min(h, MAX_FRAME_H);
+  for (int i = 0; i < f.w * f.h; i++)
+    f.cells[i] = Cell{};
+}
+
+static void frame_put(Frame &f, int y, int x, const char *s, int n,
+                      int color) {
+  if (y < 0 || y >= f.h)
+    return;
+  Cell *row = &f.cells[y * f.w];
+  for (int i = 0; i < n && s[i]; i++) {
+    int cx = x + i;
+    if (cx < 0)
+      continue;
+    if (cx >= f.w)
+      break;
+    row[cx].ch = s[i];
+    row[cx].color = static_cast<unsigned char>(color);
+  }
+}
+
+static void frame_printf(Frame &f, int y, int x, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void frame_printf(Frame &f, int y, int x, const char *fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n > 0)
+    frame_put(f, y, x, buf, std::min(n, static_cast<int>(sizeof(buf)) - 1), 0);
+}
+
+// Backends de salida
+enum RenderBackend { BACKEND_NCURSES = 0, BACKEND_ANSI = 1 };
+static int opt_backend = BACKEND_NCURSES;
+
+/**
+ * Backend ncurses: copia el cuadro al buffer trasero por tramos del mismo
+ * color y deja que doupdate() calcule la diferencia.
+ */
+static void present_ncurses(const Frame &f, int far_rows) {
+  WINDOW *win = backwin ? backwin : stdscr;
+  werase(win);
+  for (int y = 0; y < f.h; y++) {
+    const Cell *row = &f.cells[y * f.w];
+    int x = 0;
+    while (x < f.w) {
+      if (row[x].ch == ' ') {
+        x++;
+        continue;
+      }
+      int start = x;
+      unsigned char color = row[x].color;
+      char run[MAX_FRAME_W];
+      int n = 0;
+      while (x < f.w && row[x].ch != ' ' && row[x].color == color)
+        run[n++] = row[x++].ch;
+      if (color)
+        wattron(win, COLOR_PAIR(color));
+      mvwaddnstr(win, y, start, run, n);
+      if (color)
+        wattroff(win, COLOR_PAIR(color));
+    }
+  }
+  if (far_rows > 0)
+    wtouchln(win, 0, far_rows, 0);
+  wnoutrefresh(win);
+  term_capture_begin();
+  doupdate();
+  term_capture_end();
+}
+
+/**
+ * Backend ANSI: compara con el cuadro anterior, arma las secuencias de
+ * movimiento de cursor y SGR en un buffer preasignado y lo envía con una
+ * única escritura por term_out.
+ */
+constexpr int ANSI_MAX_BYTES_PER_CELL = 24;
+static char ansi_buf[MAX_FRAME_W * MAX_FRAME_H * ANSI_MAX_BYTES_PER_CELL];
+static bool ansi_full_redraw = true;
+// Color activo en la terminal, -1 = desconocido
+static int ansi_term_color = -1;
+
+static inline char *ansi_append(char *p, const char *s) {
+  while (*s)
+    *p++ = *s++;
+  return p;
+}
+
+static inline char *ansi_append_int(char *p, int v) {
+  char tmp[12];
+  int n = 0;
+  do {
+    tmp[n++] = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v > 0);
+  while (n > 0)
+    *p++ = tmp[--n];
+  return p;
+}
+
+// Color de primer plano equivalente a cada par de ncurses
+static const char *ansi_sgr_for_color(unsigned char color) {
+  switch (color) {
+  case 1:
+    return "\x1b[32m"; // verde
+  case 2:
+    return "\x1b[31m"; // rojo
+  case 3:
+    return "\x1b[33m"; // amarillo
+  default:
+    return "\x1b[39m";
+  }
+}
+
+static void present_ansi(const Frame &f, int far_rows) {
+  bool full = ansi_full_redraw || f.w != frame_prev.w || f.h != frame_prev.h;
+  char *p = ansi_buf;
+  if (full)
+    p = ansi_append(p, "\x1b[0m\x1b[H\x1b[2J");
+  int cur_y = -1, cur_x = -1;
+  if (full)
+    ansi_term_color = 0;
+  for (int y = full ? 0 : far_rows; y < f.h; y++) {
+    const Cell *row = &f.cells[y * f.w];
+    const Cell *old = &frame_prev.cells[y * f.w];
+    for (int x = 0; x < f.w; x++) {
+      const Cell &c = row[x];
+      bool same = c.ch == old[x].ch && (c.ch == ' ' || c.color == old[x].color);
+      if (full ? c.ch == ' ' : same)
+        continue;
+      if (cur_y != y || cur_x != x) {
+        p = ansi_append(p, "\x1b[");
+        p = ansi_append_int(p, y + 1);
+        *p++ = ';';
+        p = ansi_append_int(p, x + 1);
+        *p++ = 'H';
+      }
+      if (c.ch != ' ' && c.color != ansi_term_color) {
+        p = ansi_append(p, ansi_sgr_for_color(c.color));
+        ansi_term_color = c.color;
+      }
+      *p++ = c.ch;
+      cur_y = y;
+      cur_x = x + 1;
+    }
+  }
+  // Las filas lejanas omitidas se conservan para compararlas más adelante
+  for (int y = full ? 0 : far_rows; y < f.h; y++)
+    std::memcpy(&frame_prev.cells[y * f.w], &f.cells[y * f.w],
+                sizeof(Cell) * f.w);
+  frame_prev.w = f.w;
+  frame_prev.h = f.h;
+  ansi_full_redraw = false;
+
+  std::fwrite(ansi_buf, 1, static_cast<size_t>(p - ansi_buf), term_out);
+}
+
+// Devuelve la terminal a ncurses: restablece atributos y fuerza un redibujado
+// completo la próxima vez que se use el backend ANSI.
+static void ansi_backend_release() {
+  if (ansi_term_color != 0 && ansi_term_color != -1)
+    std::fputs("\x1b[0m", term_out);
+  ansi_term_color = -1;
+  ansi_full_redraw = true;
+  clearok(curscr, TRUE);
+}
+
+/**
+ * Grabación de cuadros ("video")
+ * Cada cuadro enviado se guarda como diferencia comprimida contra el anterior,
+ * con un cuadro clave completo cada REC_KEYFRAME_INTERVAL cuadros para poder
+ * buscar. draw_screen() solo copia el cuadro a un anillo acotado; un hilo de
+ * fondo codifica y escribe. Si el anillo está lleno el cuadro se descarta.
+ *
+ * Formato: cabecera REC_MAGIC + versión (u32), luego registros
+ *   u8 tipo | u32 t_ms | u16 ancho | u16 alto | u32 largo | datos
+ * Cuadro clave: tramos RLE (varint cantidad, carácter, color).
+ * Diferencia: (varint celdas sin cambio, varint n, n * (carácter, color)).
+ */
+constexpr char REC_MAGIC[8] = {'G', 'L', 'G', 'R', 'E', 'C', '1', '\0'};
+constexpr uint32_t REC_VERSION = 1;
+constexpr int REC_KEYFRAME_INTERVAL = 40; // ~1 s de juego
+constexpr int REC_RING_SLOTS = 8;
+constexpr uint8_t REC_KEYFRAME = 1;
+constexpr uint8_t REC_DELTA = 2;
+constexpr size_t REC_HEADER_BYTES = 13;
+
+struct RecSlot {
+  long long t_ms = 0;
+  int w = 0, h = 0;
+  Cell cells[MAX_FRAME_H * MAX_FRAME_W];
+};
+
+struct Recorder {
+  FILE *file = nullptr;
+  long long start_ms = 0;
+  std::thread writer;
+  std::atomic<bool> stop{false};
+  // Anillo de un productor (render) y un consumidor (escritor)
+  RecSlot slots[REC_RING_SLOTS];
+  std::atomic<unsigned> head{0}, tail{0};
+  std::mutex mutex;
+  std::condition_variable cv;
+  long long frames_written = 0;
+  std::atomic<long long> frames_dropped{0};
+  // Estado del escritor
+  Frame last;
+  int since_keyframe = 0;
+  std::vector<unsigned char> buf;
+};
+// Solo se reserva cuando se pide --record
+static std::unique_ptr<Recorder> recorder;
+
+static inline void put_varint(std::vector<unsigned char> &out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<unsigned char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(v));
+}
+
+static inline bool get_varint(const unsigned char *&p,
+                              const unsigned char *end, uint32_t &v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 35; shift += 7) {
+    unsigned char b = *p++;
+    v |= static_cast<uint32_t>(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static void rec_encode_keyframe(std::vector<unsigned char> &out,
+                                const Cell *cells, int n) {
+  for (int i = 0; i < n;) {
+    int j = i + 1;
+    while (j < n && cells[j].ch == cells[i].ch &&
+           cells[j].color == cells[i].color)
+      j++;
+    put_varint(out, static_cast<uint32_t>(j - i));
+    out.push_back(static_cast<unsigned char>(cells[i].ch));
+    out.push_back(cells[i].color);
+    i = j;
+  }
+}
+
+static void rec_encode_delta(std::vector<unsigned char> &out,
+                             const Cell *cells, const Cell *prev, int n) {
+  int i = 0;
+  while (i < n) {
+    int start = i;
+    while (i < n && cells[i].ch == prev[i].ch &&
+           cells[i].color == prev[i].color)
+      i++;
+    if (i == n)
+      break;
+    int skip = i - start;
+    int run = i;
+    while (run < n && (cells[run].ch != prev[run].ch ||
+                       cells[run].color != prev[run].color))
+      run++;
+    put_varint(out, static_cast<uint32_t>(skip));
+    put_varint(out, static_cast<uint32_t>(run - i));
+    for (; i < run; i++) {
+      out.push_back(static_cast<unsigned char>(cells[i].ch));
+      out.push_back(cells[i].color);
+    }
+  }
+}
+
+static void rec_write_u16(unsigned char *p, uint32_t v) {
+  p[0] = static_cast<unsigned char>(v);
+  p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+static void rec_write_u32(unsigned char *p, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static uint32_t rec_read_u32(const unsigned char *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void rec_write_slot(Recorder &r, const RecSlot &s) {
+  int n = s.w * s.h;
+  // Las diferencias siempre son contra el último cuadro escrito, así que los
+  // cuadros descartados no rompen la cadena.
+  bool key = r.since_keyframe >= REC_KEYFRAME_INTERVAL || s.w != r.last.w ||
+             s.h != r.last.h;
+  r.buf.assign(REC_HEADER_BYTES, 0);
+  if (key) {
+    rec_encode_keyframe(r.buf, s.cells, n);
+    r.since_keyframe = 0;
+  } else {
+    rec_encode_delta(r.buf, s.cells, r.last.cells, n);
+  }
+  r.since_keyframe++;
+  unsigned char *h = r.buf.data();
+  h[0] = key ? REC_KEYFRAME : REC_DELTA;
+  rec_write_u32(h + 1, static_cast<uint32_t>(s.t_ms));
+  rec_write_u16(h + 5, static_cast<uint32_t>(s.w));
+  rec_write_u16(h + 7, static_cast<uint32_t>(s.h));
+  rec_write_u32(h + 9,
+                static_cast<uint32_t>(r.buf.size() - REC_HEADER_BYTES));
+  std::fwrite(r.buf.data(), 1, r.buf.size(), r.file);
+  std::memcpy(r.last.cells, s.cells, sizeof(Cell) * n);
+  r.last.w = s.w;
+  r.last.h = s.h;
+  r.frames_written++;
+}
+
+static void recorder_writer_loop(Recorder &r) {
+  while (true) {
+    unsigned tail = r.tail.load(std::memory_order_relaxed);
+    if (tail == r.head.load(std::memory_order_acquire)) {
+      if (r.stop.load())
+        break;
+      std::unique_lock<std::mutex> lock(r.mutex);
+      r.cv.wait_for(lock, std::chrono::milliseconds(50));
+      continue;
+    }
+    rec_write_slot(r, r.slots[tail % REC_RING_SLOTS]);
+    r.tail.store(tail + 1, std::memory_order_release);
+  }
+  std::fflush(r.file);
+}
+
+static bool recorder_open(const char *path) {
+  FILE *file = std::fopen(path, "wb");
+  if (!file)
+    return false;
+  recorder.reset(new Recorder);
+  Recorder &r = *recorder;
+  r.file = file;
+  unsigned char hdr[12];
+  std::memcpy(hdr, REC_MAGIC, 8);
+  rec_write_u32(hdr + 8, REC_VERSION);
+  std::fwrite(hdr, 1, sizeof(hdr), r.file);
+  r.buf.reserve(1 << 16);
+  r.start_ms = now_ms();
+  r.writer = std::thread(recorder_writer_loop, std::ref(r));
+  return true;
+}
+
+// Llamado por draw_screen(): copia el cuadro al anillo sin bloquear
+static void recorder_push(const Frame &f) {
+  Recorder &r = *recorder;
+  unsigned head = r.head.load(std::memory_order_relaxed);
+  if (head - r.tail.load(std::memory_order_acquire) >= REC_RING_SLOTS) {
+    r.frames_dropped++;
+    return;
+  }
+  RecSlot &s = r.slots[head % REC_RING_SLOTS];
+  s.t_ms = now_ms() - r.start_ms;
+  s.w = f.w;
+  s.h = f.h;
+  std::memcpy(s.cells, f.cells, sizeof(Cell) * f.w * f.h);
+  r.head.store(head + 1, std::memory_order_release);
+  r.cv.notify_one();
+}
+
+static void recorder_close() {
+  if (!recorder)
+    return;
+  Recorder &r = *recorder;
+  r.stop = true;
+  r.cv.notify_one();
+  r.writer.join();
+  std::fclose(r.file);
+  std::fprintf(stderr, "Grabación: %lld cuadros escritos, %lld descartados\n",
+               r.frames_written, r.frames_dropped.load());
+  recorder.reset();
+}
+
+/**
+ * Visor de grabaciones (--play-recording)
+ * Al abrir solo se leen las cabeceras de los registros para armar un índice;
+ * para saltar a un instante se decodifica el último cuadro clave anterior y
+ * las diferencias hasta ese instante, a lo sumo REC_KEYFRAME_INTERVAL cuadros.
+ */
+struct RecIndexEntry {
+  uint32_t t_ms;
+  size_t offset; // inicio de los datos del registro
+  uint32_t len;
+  uint8_t type;
+  int w, h;
+};
+
+struct Recording {
+  std::vector<unsigned char> data;
+  std::vector<RecIndexEntry> index;
+  std::vector<int> keyframes; // posiciones en index
+  Frame frame;                // cuadro decodificado
+  int cur = -1;               // registro aplicado en frame
+};
+
+static bool rec_load(const char *path, Recording &rec) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  rec.data.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  const unsigned char *d = rec.data.data();
+  size_t size = rec.data.size();
+  if (size < 12 || std::memcmp(d, REC_MAGIC, 8) != 0 ||
+      rec_read_u32(d + 8) != REC_VERSION)
+    return false;
+  size_t off = 12;
+  while (off + REC_HEADER_BYTES <= size) {
+    RecIndexEntry e;
+    e.type = d[off];
+    e.t_ms = rec_read_u32(d + off + 1);
+    e.w = d[off + 5] | (d[off + 6] << 8);
+    e.h = d[off + 7] | (d[off + 8] << 8);
+    e.len = rec_read_u32(d + off + 9);
+    e.offset = off + REC_HEADER_BYTES;
+    if (e.offset + e.len > size || e.w <= 0 || e.h <= 0 ||
+        e.w > MAX_FRAME_W || e.h > MAX_FRAME_H ||
+        (e.type != REC_KEYFRAME && e.type != REC_DELTA))
+      break; // registro truncado: se usa lo anterior
+    if (e.type == REC_KEYFRAME)
+      rec.keyframes.push_back(static_cast<int>(rec.index.size()));
+    // Una diferencia antes del primer cuadro clave no se puede decodificar
+    if (!rec.keyframes.empty())
+      rec.index.push_back(e);
+    off = e.offset + e.len;
+  }
+  return !rec.index.empty();
+}
+
+// Aplica el registro i sobre rec.frame (que debe contener el registro i-1 si
+// es una diferencia)
+static void rec_apply(Recording &rec, int i) {
+  const RecIndexEntry &e = rec.index[i];
+  const unsigned char *p = rec.data.data() + e.offset;
+  const unsigned char *end = p + e.len;
+  Frame &f = rec.frame;
+  int n = e.w * e.h;
+  f.w = e.w;
+  f.h = e.h;
+  uint32_t a, b;
+  if (e.type == REC_KEYFRAME) {
+    int pos = 0;
+    while (pos < n && get_varint(p, end, a) && end - p >= 2) {
+      Cell c;
+      c.ch = static_cast<char>(p[0]);
+      c.color = p[1];
+      p += 2;
+      for (uint32_t k = 0; k < a && pos < n; k++)
+        f.cells[pos++] = c;
+    }
+  } else {
+    int pos = 0;
+    while (pos < n && get_varint(p, end, a) && get_varint(p, end, b)) {
+      pos += static_cast<int>(a);
+      for (uint32_t k = 0; k < b && pos < n && end - p >= 2; k++, p += 2) {
+        f.cells[pos].ch = static_cast<char>(p[0]);
+        f.cells[pos++].color = p[1];
+      }
+    }
+  }
+  rec.cur = i;
+}
+
+// Último registro con t_ms <= t (al menos el primero)
+static int rec_find(const Recording &rec, long long t) {
+  auto it = std::upper_bound(
+      rec.index.begin(), rec.index.end(), t,
+      [](long long v, const RecIndexEntry &e) { return v < e.t_ms; });
+  return std::max(0, static_cast<int>(it - rec.index.begin()) - 1);
+}
+
+static void rec_seek(Recording &rec, int target) {
+  int start;
+  if (rec.cur >= 0 && rec.cur <= target &&
+      target - rec.cur <= REC_KEYFRAME_INTERVAL) {
+    start = rec.cur + 1; // avanzar desde el cuadro actual
+  } else {
+    auto it =
+        std::upper_bound(rec.keyframes.begin(), rec.keyframes.end(), target);
+    start = *(it - 1);
+  }
+  for (int i = start; i <= target; i++)
+    rec_apply(rec, i);
+}
+
+static void play_recording(Recording &rec) {
+  nodelay(stdscr, TRUE);
+  keypad(stdscr, TRUE);
+  long long total_ms = rec.index.back().t_ms;
+  long long pos_ms = 0;
+  long long wall_base = now_ms();
+  bool paused = false;
+  bool quit = false;
+  while (!quit) {
+    int ch;
+    while ((ch = getch()) != ERR) {
+      long long jump = -1;
+      if (ch == 'q' || ch == 'Q')
+        quit = true;
+      else if (ch == ' ')
+        paused = !paused;
+      else if (ch == KEY_LEFT)
+        jump = std::max(0LL, pos_ms - 5000);
+      else if (ch == KEY_RIGHT)
+        jump = std::min(total_ms, pos_ms + 5000);
+      else if (ch >= '0' && ch <= '9')
+        jump = total_ms * (ch - '0') / 10;
+      if (jump >= 0)
+        pos_ms = jump;
+      wall_base = now_ms() - pos_ms;
+    }
+    if (!paused)
+      pos_ms = std::min(total_ms, now_ms() - wall_base);
+
+    rec_seek(rec, rec_find(rec, pos_ms));
+
+    // Copiar el cuadro grabado recortado a la terminal actual
+    int screen_h, screen_w;
+    getmaxyx(stdscr, screen_h, screen_w);
+    Frame &f = frame_cur;
+    frame_begin(f, screen_w, screen_h);
+    int cw = std::min(rec.frame.w, f.w);
+    int chh = std::min(rec.frame.h, f.h - 1);
+    for (int y = 0; y < chh; y++)
+      std::memcpy(&f.cells[y * f.w], &rec.frame.cells[y * rec.frame.w],
+                  sizeof(Cell) * cw);
+    frame_printf(f, f.h - 1, 0,
+                 "%s %02lld:%02lld.%lld / %02lld:%02lld  cuadro %d/%zu  "
+                 "[espacio] pausa  [<-/->] 5 s  [0-9] saltar  [q] salir",
+                 paused ? "PAUSA" : ">>", pos_ms / 60000, pos_ms / 1000 % 60,
+                 pos_ms / 100 % 10, total_ms / 60000, total_ms / 1000 % 60,
+                 rec.cur + 1, rec.index.size());
+    present_ncurses(f, 0);
+    if (!paused && pos_ms >= total_ms)
+      paused = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(RENDER_INTERVAL_MS));
+  }
+}
+
+static void init_curses() {
+  term_out_open();
+  if (!curses_out)
+    curses_out = fdopen(dup(STDOUT_FILENO), "w");
+  if (!curses_out || !newterm(nullptr, curses_out, stdin)) {
+    std::fprintf(stderr, "No se pudo iniciar la terminal (TERM=%s)\n",
+                 std::getenv("TERM") ? std::getenv("TERM") : "");
+    std::exit(1);
+  }
+  cbreak();
+  noecho();
+  curs_set(0);
+  if (has_colors()) {
+    start_color();
+    use_default_colors();
+    init_pair(1, COLOR_GREEN, -1);  // Jugador
+    init_pair(2, COLOR_RED, -1);    // Enemigo
+    init_pair(3, COLOR_YELLOW, -1); // Balas
+  }
 }
 
 /**
- * Hilo 2: Manejo de balas enemigas
- * Actualiza la posición de las balas enemigas y elimina las que salen de
- * pantalla
+ * Espectadores (--watch)
+ * La partida publica cada cuadro compuesto en un anillo de memoria
+ * compartida POSIX (/galaga-PID) con un solo escritor (el render) y
+ * cualquier cantidad de lectores. Cada ranura lleva un contador seqlock,
+ * impar mientras se escribe: el escritor nunca espera a nadie, y un lector
+ * copia el último cuadro publicado y verifica que el contador no cambió. Si
+ * cambió (el escritor dio la vuelta al anillo) descarta la copia y vuelve a
+ * intentar con el más nuevo, así un espectador lento solo saltea cuadros.
  */
-void *enemy_bullet_manager_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    for (int b = 0; b < MAX_BULLETS; b++) {
-      if (ebullets[b].active) {
-        ebullets[b].y += ENEMY_BULLET_SPEED;
-        if (ebullets[b].y >= screen_h)
-          ebullets[b].active = false;
+constexpr char SPECTATE_MAGIC[8] = {'G', 'L', 'G', 'S', 'P', 'C', '1', '\0'};
+constexpr uint32_t SPECTATE_VERSION = 1;
+constexpr int SPECTATE_SLOTS = 4;
+constexpr const char *SPECTATE_PREFIX = "galaga-";
+// Cada cuánto el espectador verifica que la partida sigue viva
+constexpr int SPECTATE_ALIVE_CHECK_MS = 500;
+// Lecturas fallidas seguidas antes de esperar al próximo cuadro
+constexpr int SPECTATE_READ_TRIES = 4;
+
+struct SpectateSlot {
+  std::atomic<uint32_t> seq;
+  uint64_t frame_no;
+  uint16_t w, h;
+  Cell cells[MAX_FRAME_H * MAX_FRAME_W];
+};
+
+struct SpectateShm {
+  char magic[8];
+  uint32_t version;
+  int32_t pid;
+  std::atomic<uint64_t> latest; // último cuadro publicado, 0 = ninguno
+  SpectateSlot slots[SPECTATE_SLOTS];
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "Los contadores compartidos entre procesos deben ser sin lock");
+
+static SpectateShm *spectate_map = nullptr;
+static char spectate_name[32];
+
+static bool spectate_open() {
+  std::snprintf(spectate_name, sizeof(spectate_name), "/%s%d",
+                SPECTATE_PREFIX, static_cast<int>(getpid()));
+  int fd = shm_open(spectate_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    return false;
+  void *p = MAP_FAILED;
+  if (ftruncate(fd, sizeof(SpectateShm)) == 0)
+    p = mmap(nullptr, sizeof(SpectateShm), PROT_READ | PROT_WRITE, MAP_SHARED,
+             fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_unlink(spectate_name);
+    return false;
+  }
+  // ftruncate() deja todo en cero: contadores pares y ningún cuadro
+  spectate_map = static_cast<SpectateShm *>(p);
+  spectate_map->version = SPECTATE_VERSION;
+  spectate_map->pid = static_cast<int32_t>(getpid());
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(spectate_map->magic, SPECTATE_MAGIC, sizeof(SPECTATE_MAGIC));
+  return true;
+}
+
+// Llamado por draw_screen(): nunca bloquea
+static void spectate_publish(const Frame &f) {
+  SpectateShm &m = *spectate_map;
+  uint64_t n = m.latest.load(std::memory_order_relaxed) + 1;
+  SpectateSlot &s = m.slots[n % SPECTATE_SLOTS];
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  s.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.frame_no = n;
+  s.w = static_cast<uint16_t>(f.w);
+  s.h = static_cast<uint16_t>(f.h);
+  std::memcpy(s.cells, f.cells, sizeof(Cell) * f.w * f.h);
+  s.seq.store(seq + 2, std::memory_order_release);
+  m.latest.store(n, std::memory_order_release);
+}
+
+static void spectate_close() {
+  if (!spectate_map)
+    return;
+  munmap(spectate_map, sizeof(SpectateShm));
+  shm_unlink(spectate_name);
+  spectate_map = nullptr;
+}
+
+// Copia el cuadro n a out; false si se estaba escribiendo o ya se reemplazó
+static bool spectate_read(const SpectateShm &m, uint64_t n, Frame &out) {
+  const SpectateSlot &s = m.slots[n % SPECTATE_SLOTS];
+  uint32_t seq = s.seq.load(std::memory_order_acquire);
+  if (seq & 1)
+    return false;
+  uint64_t frame_no = s.frame_no;
+  int w = std::min<int>(s.w, MAX_FRAME_W), h = std::min<int>(s.h, MAX_FRAME_H);
+  std::memcpy(out.cells, s.cells, sizeof(Cell) * w * h);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (s.seq.load(std::memory_order_relaxed) != seq || frame_no != n)
+    return false;
+  out.w = w;
+  out.h = h;
+  return true;
+}
+
+static bool process_alive(int pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+// Partida a observar: la pedida o la más reciente que siga viva. Borra los
+// anillos que dejaron partidas terminadas de forma abrupta.
+static int spectate_find_pid() {
+  if (opt_watch_pid > 0)
+    return opt_watch_pid;
+  DIR *dir = opendir("/dev/shm");
+  if (!dir)
+    return 0;
+  int best_pid = 0;
+  long long best_mtime = -1;
+  size_t plen = std::strlen(SPECTATE_PREFIX);
+  while (struct dirent *e = readdir(dir)) {
+    if (std::strncmp(e->d_name, SPECTATE_PREFIX, plen) != 0)
+      continue;
+    int pid = std::atoi(e->d_name + plen);
+    if (pid <= 0)
+      continue;
+    char name[32], path[48];
+    std::snprintf(name, sizeof(name), "/%s%d", SPECTATE_PREFIX, pid);
+    if (!process_alive(pid)) {
+      shm_unlink(name);
+      continue;
+    }
+    std::snprintf(path, sizeof(path), "/dev/shm%s", name);
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_mtime > best_mtime) {
+      best_mtime = st.st_mtime;
+      best_pid = pid;
+    }
+  }
+  closedir(dir);
+  return best_pid;
+}
+
+static int run_watch() {
+  int pid = spectate_find_pid();
+  if (pid <= 0) {
+    std::fprintf(stderr, "No hay partidas en curso para observar\n");
+    return 1;
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%s%d", SPECTATE_PREFIX, pid);
+  int fd = shm_open(name, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 ||
+      st.st_size != static_cast<off_t>(sizeof(SpectateShm))) {
+    std::fprintf(stderr, "No se puede observar la partida %d\n", pid);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  void *p = mmap(nullptr, sizeof(SpectateShm), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    std::perror("mmap");
+    return 1;
+  }
+  const SpectateShm &m = *static_cast<const SpectateShm *>(p);
+  if (std::memcmp(m.magic, SPECTATE_MAGIC, sizeof(SPECTATE_MAGIC)) != 0 ||
+      m.version != SPECTATE_VERSION) {
+    std::fprintf(stderr, "Versión de anillo incompatible en %s\n", name);
+    munmap(p, sizeof(SpectateShm));
+    return 1;
+  }
+
+  init_curses();
+  nodelay(stdscr, TRUE);
+  // El último cuadro leído se conserva mientras no llegan nuevos; se lee en
+  // otro para que una lectura fallida no lo pise a medias
+  static Frame frames[2];
+  Frame *shown = &frames[0], *incoming = &frames[1];
+  uint64_t shown_no = 0;
+  long long skipped = 0, retries = 0;
+  long long next_alive_check = 0;
+  bool game_alive = true;
+  while (true) {
+    int ch = getch();
+    if (ch == 'q' || ch == 'Q')
+      break;
+    long long now = now_ms();
+    if (now >= next_alive_check) {
+      game_alive = process_alive(pid);
+      next_alive_check = now + SPECTATE_ALIVE_CHECK_MS;
+    }
+    // Si el escritor da la vuelta al anillo o murió a mitad de un cuadro
+    // se reintenta unas pocas veces y se sigue mostrando el anterior; con
+    // la partida terminada no llega nada nuevo
+    for (int tries = 0; game_alive && tries < SPECTATE_READ_TRIES; tries++) {
+      uint64_t n = m.latest.load(std::memory_order_acquire);
+      if (n <= shown_no)
+        break;
+      if (spectate_read(m, n, *incoming)) {
+        if (shown_no > 0)
+          skipped += n - shown_no - 1;
+        shown_no = n;
+        std::swap(shown, incoming);
+        break;
       }
+      retries++;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+
+    int screen_h, screen_w;
+    getmaxyx(stdscr, screen_h, screen_w);
+    Frame &f = frame_cur;
+    frame_begin(f, screen_w, screen_h);
+    int cw = std::min(shown->w, f.w);
+    int chh = std::min(shown->h, f.h - 1);
+    for (int y = 0; y < chh; y++)
+      std::memcpy(&f.cells[y * f.w], &shown->cells[y * shown->w],
+                  sizeof(Cell) * cw);
+    frame_printf(f, f.h - 1, 0,
+                 "ESPECTADOR  partida %d%s  cuadro %llu  salteados %lld  "
+                 "[q] salir",
+                 pid, game_alive ? "" : " (terminó)",
+                 static_cast<unsigned long long>(shown_no), skipped);
+    present_ncurses(f, 0);
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(RENDER_INTERVAL_MS / 2));
   }
-  return nullptr;
+  endwin();
+  munmap(p, sizeof(SpectateShm));
+  std::fprintf(stderr,
+               "Espectador: %llu cuadros publicados, %lld salteados, %lld "
+               "lecturas repetidas\n",
+               static_cast<unsigned long long>(shown_no), skipped, retries);
+  return 0;
+}
+
+// Fracción de tick transcurrida desde el último paso de un sistema, en [0, 1]
+static inline float tick_alpha(long long last_tick_ms, long long now) {
+  if (last_tick_ms <= 0)
+    return 1.0f;
+  float a = static_cast<float>(now - last_tick_ms) / opt_tick_ms;
+  return std::min(1.0f, std::max(0.0f, a));
 }
 
+static inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
 /**
- * Hilo 3: Detector de colisiones entre balas del jugador y enemigos
- * Detecta cuando las balas del jugador atinan
+ * Compone el cuadro del juego con todos los elementos, sin usar el heap.
+ * Las posiciones de la nave y las balas se interpolan entre el tick anterior
+ * y el actual de su sistema, así el movimiento es suave aunque el render y la
+ * simulación corran a ritmos distintos.
  */
+static void compose_frame(GameWorld &w, Frame &f) {
+  // Capturar estado bajo lock
+  struct ScreenPos {
+    int x, y;
+  };
+  struct GameSnapshot {
+    int score;
+    int lives;
+    int mode;
+    int group;
+    int enemies_destroyed;
+    int ship_x;
+    int ship_y;
+    bool is_hit;
+    ScreenPos player_bullets[MAX_BULLETS];
+    ScreenPos enemy_bullets[MAX_BULLETS];
+    ScreenPos alive_enemies[MAX_ENEMIES];
+    int n_player_bullets = 0;
+    int n_enemy_bullets = 0;
+    int n_alive_enemies = 0;
+  } snapshot;
 
-void *player_bullet_collision_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    {
-      std::lock_guard<std::mutex> lock1(bullet_mutex);
-      std::lock_guard<std::mutex> lock2(enemy_mutex);
-
-      for (int i = 0; i < MAX_BULLETS; i++) {
-        if (bullets[i].active) {
-          for (int e = 0; e < MAX_ENEMIES; e++) {
-            if (enemies[e].alive) {
-              int bx = static_cast<int>(std::round(bullets[i].x));
-              int by = static_cast<int>(std::round(bullets[i].y));
-              int ex = static_cast<int>(std::round(enemies[e].x));
-              int ey = static_cast<int>(std::round(enemies[e].y));
-
-              if (bx >= ex && bx < ex + ENEMY_W && by >= ey &&
-                  by < ey + ENEMY_H) {
-                enemies[e].alive = false;
-                bullets[i].active = false;
-                {
-                  std::lock_guard<std::mutex> score_lock(score_mutex);
-                  player_score += 10;
-                  enemies_destroyed++;
-                  enemies_in_current_group--;
-                }
-              }
-            }
-          }
-        }
-      }
+  long long now = now_ms();
+  float ship_alpha = tick_alpha(w.ship_tick_ms.load(), now);
+  float bullet_alpha = tick_alpha(w.bullet_tick_ms.load(), now);
+  float ebullet_alpha = tick_alpha(w.ebullet_tick_ms.load(), now);
+  {
+    TracedLock lock(w.game_state_mutex, "game_state_mutex");
+    snapshot.score = w.player_score;
+    snapshot.lives = w.player_lives;
+    snapshot.mode = w.game_mode;
+    snapshot.group = w.current_group + 1;
+    snapshot.enemies_destroyed = w.enemies_destroyed;
+    snapshot.ship_x = static_cast<int>(
+        std::round(lerp(w.prev_ship_fx, w.ship_fx, ship_alpha)));
+    snapshot.ship_y = w.ship_y;
+
+    snapshot.is_hit = w.player_hit.load();
+    // Si un cuadro anterior no se envió se mide desde la tecla más antigua
+    if (w.input_applied_key_us && input_latency.pending_key_us == 0) {
+      input_latency.pending_key_us = w.input_applied_key_us;
+      input_latency.pending_applied_us = w.input_applied_us;
     }
-    std::this_thread::sleep_for(
-        std::chrono::milliseconds(UPDATE_INTERVAL_MS / 2));
+    w.input_applied_key_us = w.input_applied_us = 0;
+
+    for (int i = 0; i < MAX_BULLETS; i++)
+      if (w.bullets[i].active)
+        snapshot.player_bullets[snapshot.n_player_bullets++] = {
+            static_cast<int>(std::round(w.bullets[i].x)),
+            static_cast<int>(std::round(
+                lerp(w.bullets[i].prev_y, w.bullets[i].y, bullet_alpha)))};
+    for (int i = 0; i < MAX_BULLETS; i++)
+      if (w.ebullets[i].active)
+        snapshot.enemy_bullets[snapshot.n_enemy_bullets++] = {
+            static_cast<int>(std::round(w.ebullets[i].x)),
+            static_cast<int>(std::round(
+                lerp(w.ebullets[i].prev_y, w.ebullets[i].y, ebullet_alpha)))};
+    for (int i = 0; i < MAX_ENEMIES; i++)
+      if (w.enemies[i].alive)
+        snapshot.alive_enemies[snapshot.n_alive_enemies++] = {
+            static_cast<int>(std::round(enemy_x(w, w.enemies[i]))),
+            static_cast<int>(std::round(enemy_y(w, w.enemies[i])))};
+  }
+
+  // Componer el cuadro
+  frame_begin(f, w.screen_w, w.screen_h);
+  bool colors = use_colors();
+
+  // Calcular posiciones del HUD
+  int hud_left = 2;
+  int hud_best = w.screen_w / 2 - 12;
+  int hud_lives = w.screen_w / 2 + 6;
+  int hud_mode = w.screen_w - 15;
+  if (hud_best < hud_left + 12)
+    hud_best = hud_left + 12;
+  if (hud_lives <= hud_best + 10)
+    hud_lives = hud_best + 12;
+  if (hud_mode <= hud_lives + 8)
+    hud_mode = hud_lives + 10;
+  if (hud_mode >= w.screen_w - 1)
+    hud_mode = std::max(hud_lives + 6, w.screen_w - 15);
+  frame_printf(f, 0, hud_left, "Puntaje: %d", snapshot.score);
+  frame_printf(f, 0, hud_best, "Mejor: %d", saved_highscore);
+  frame_printf(f, 0, hud_lives, "Vidas: %d", snapshot.lives);
+  frame_printf(f, 0, hud_mode, "Modo %d G%d", snapshot.mode, snapshot.group);
+  const char *notice = state_notice.load();
+  if (notice && now_ms() < state_notice_until_ms.load())
+    frame_printf(f, 1, hud_left, "%s", notice);
+
+  // Centrar nave
+  int ship_screen_x = ship_draw_x(snapshot.ship_x, w.screen_w);
+
+  // Partículas debajo de todo lo demás
+  {
+    ParticlePool &p = w.particles;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    int start = (p.head - p.count + PARTICLE_CAPACITY) % PARTICLE_CAPACITY;
+    for (int k = 0; k < p.count; k++) {
+      int i = (start + k) % PARTICLE_CAPACITY;
+      if (p.life[i] == 0 || p.y[i] < 1)
+        continue;
+      frame_put(f, static_cast<int>(std::round(p.y[i])),
+                static_cast<int>(std::round(p.x[i])), &p.glyph[i], 1,
+                colors ? p.color[i] : 0);
+    }
+  }
+
+  // Aplicar efecto visual de daño (parpadeo rojo)
+  int ship_color = colors ? (snapshot.is_hit ? 2 : 1) : 0;
+  for (int r = 0; r < SHIP_H; r++)
+    frame_put(f, snapshot.ship_y + r, ship_screen_x, SHIP_ART[r], SHIP_W,
+              ship_color);
+
+  int bullet_color = colors ? 3 : 0;
+  for (int i = 0; i < snapshot.n_player_bullets; i++)
+    frame_put(f, snapshot.player_bullets[i].y, snapshot.player_bullets[i].x,
+              "|", 1, bullet_color);
+  for (int i = 0; i < snapshot.n_enemy_bullets; i++)
+    frame_put(f, snapshot.enemy_bullets[i].y, snapshot.enemy_bullets[i].x, "!",
+              1, bullet_color);
+
+  int enemy_color = colors ? 2 : 0;
+  const char **art = enemy_art_for_level(mode_desc(snapshot.mode).art_level);
+  for (int i = 0; i < snapshot.n_alive_enemies; i++) {
+    int ex = enemy_draw_x(snapshot.alive_enemies[i].x, w.screen_w);
+    int ey = snapshot.alive_enemies[i].y;
+    for (int r = 0; r < ENEMY_H; r++)
+      frame_put(f, ey + r, ex, art[r], ENEMY_W, enemy_color);
+  }
+
+  if (opt_stats_overlay) {
+    frame_printf(f, w.screen_h - 1, 2,
+                 "Bytes/cuadro: %lld  Bytes/s: %lld  Enviados: %lld  "
+                 "Fusionados: %lld%s",
+                 term_meter.frame_bytes, term_meter.bytes_per_sec,
+                 term_meter.frames_sent, term_meter.frames_skipped,
+                 opt_lowbw_bytes_per_sec > 0 ? "  [bajo ancho de banda]" : "");
+  }
+  if (opt_stats_overlay && input_latency.total.count > 0) {
+    const LatencyHistogram &h = input_latency.total;
+    frame_printf(f, w.screen_h - 2, 2,
+                 "Tecla->cuadro: p50 %.1f  p95 %.1f  p99 %.1f ms (%lld)",
+                 latency_percentile_ms(h, 0.50), latency_percentile_ms(h, 0.95),
+                 latency_percentile_ms(h, 0.99), h.count);
+  }
+  if (opt_stats_overlay && ALLOC_TRACKING) {
+    // Todas las asignaciones del proceso desde el cuadro anterior
+    static long long last_allocs = 0;
+    long long total = heap_allocs();
+    frame_printf(f, w.screen_h - 3, 2, "Heap: %lld asignaciones/cuadro",
+                 total - last_allocs);
+    last_allocs = total;
+  }
+
+  if (w.pause.paused.load()) {
+    static const char PAUSE_TEXT[] = "PAUSA  [p] seguir  [q] salir";
+    int len = static_cast<int>(sizeof(PAUSE_TEXT)) - 1;
+    frame_printf(f, w.screen_h / 2, std::max(0, (w.screen_w - len) / 2), "%s",
+                 PAUSE_TEXT);
   }
-  return nullptr;
 }
 
 /**
- * Hilo 4: Controlador de movimiento de enemigos
- * Maneja el movimiento horizontal y vertical de los enemigos
+ * Dibuja la pantalla del juego con todos los elementos
  */
-void *enemy_movement_controller_thread(void *arg) {
-  (void)arg;
-  int enemy_direction = 1;
-  int tick_counter = 0;
-
-  while (game_running.load()) {
-    if (tick_counter % ENEMY_MOVEMENT_INTERVAL == 0) {
-      std::lock_guard<std::mutex> lock(enemy_mutex);
-
-      int wall_collision = 0;
-      for (int e = 0; e < MAX_ENEMIES; e++) {
-        if (enemies[e].alive) {
-          int next_x = enemies[e].x + enemy_direction;
-          if (next_x < 1 || next_x > screen_w - 2) {
-            wall_collision = 1;
-            break;
-          }
-        }
-      }
+void draw_screen(GameWorld &w) {
+  TraceSpan span("draw_screen", "render");
+  Frame &f = frame_cur;
+  {
+    TraceSpan compose("compose_frame", "render");
+    compose_frame(w, f);
+  }
+  if (spectate_map)
+    spectate_publish(f);
 
-      if (wall_collision) {
-        enemy_direction = -enemy_direction;
-        if (!enemy_stop_descent.load()) {
-          float lowest_enemy_y = -1.0f;
-          for (int e = 0; e < MAX_ENEMIES; e++) {
-            if (enemies[e].alive && enemies[e].y > lowest_enemy_y)
-              lowest_enemy_y = enemies[e].y;
-          }
+  // Perfil de bajo ancho de banda: si no hay presupuesto se fusiona el cuadro
+  // con el siguiente; las filas lejanas a la nave se refrescan con menor
+  // frecuencia.
+  if (!lowbw_frame_allowed()) {
+    term_meter.frames_skipped++;
+    return;
+  }
+  int far_rows = 0;
+  if (opt_lowbw_bytes_per_sec > 0 &&
+      term_meter.frame_counter++ % LOWBW_FAR_REFRESH_DIVISOR != 0)
+    far_rows = std::max(0, w.ship_y - w.screen_h / 2);
 
-          if (lowest_enemy_y + ENEMY_H + ENEMY_H >
-              static_cast<float>(MAX_ENEMY_Y)) {
-            enemy_stop_descent.store(true);
-          } else {
-            for (int e = 0; e < MAX_ENEMIES; e++) {
-              if (enemies[e].alive)
-                enemies[e].y += ENEMY_H;
-            }
-          }
-        }
-      } else {
-        for (int e = 0; e < MAX_ENEMIES; e++) {
-          if (enemies[e].alive)
-            enemies[e].x += enemy_direction;
-        }
+  // Enviar el cuadro a la pantalla real
+  long long bytes_before = term_bytes_total.load();
+  {
+    TraceSpan present("present", "render");
+    if (opt_backend == BACKEND_ANSI)
+      present_ansi(f, far_rows);
+    else
+      present_ncurses(f, far_rows);
+  }
+  term_meter_frame_sent(term_bytes_total.load() - bytes_before);
+  input_latency_frame_sent();
+  if (recorder) {
+    TraceSpan push("recorder_push", "render");
+    recorder_push(f);
+  }
+}
+
+/**
+ * Pausa la partida desde el hilo de entrada y espera, bloqueado en getch(),
+ * la tecla para seguir ('p') o salir ('q'). La nave se detiene y la tecla
+ * pendiente no se mide: la pausa no es latencia.
+ */
+static void input_pause(GameWorld &w) {
+  w.move_left = false;
+  w.move_right = false;
+  w.held_key = 0;
+  w.input_key_us = 0;
+  pause_set(w.pause, true);
+  nodelay(stdscr, FALSE);
+  int ch;
+  do {
+    ch = getch();
+    if (ch == ERR) // sin terminal no hay qué esperar; no girar en vacío
+      std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_INTERVAL_MS));
+  } while (ch != 'p' && ch != 'P' && ch != 'q' && ch != 'Q');
+  nodelay(stdscr, TRUE);
+  if (ch == 'q' || ch == 'Q') {
+    w.user_quit = true;
+    w.game_running = false;
+  }
+  pause_set(w.pause, false);
+}
+
+// Marca la lectura de una tecla; se conserva la más antigua sin aplicar
+static inline void input_stamp(GameWorld &w) {
+  long long expected = 0;
+  w.input_key_us.compare_exchange_strong(expected, now_us());
+}
+
+/**
+ * Bucle de entrada de teclado
+ * Maneja el input del usuario
+ */
+void input_loop(GameWorld &w) {
+  TraceThread trace_thread("input");
+  int ch;
+  nodelay(stdscr, TRUE);
+  keypad(stdscr, TRUE);
+  while (w.game_running.load()) {
+    ch = getch();
+    if (ch == ERR) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_INTERVAL_MS));
+      continue;
+    }
+
+    // Terminar juego
+    if (ch == 'q' || ch == 'Q') {
+      w.user_quit = true;
+      w.game_running = false;
+    } else if (ch == 'p' || ch == 'P') {
+      input_pause(w);
+      continue;
+    } else if (opt_autopilot) {
+      // Con piloto automático solo se atiende la tecla de salida
+    } else if (ch == KEY_LEFT || ch == 'a' || ch == 'A') {
+      // tecla izquierda
+      input_stamp(w);
+      w.held_key.store(-1);
+      w.move_left = true;
+      w.move_right = false;
+      timer_schedule(w, w.movement_timer, movement_timeout,
+                     timer_ticks(MOVEMENT_TIMEOUT_MS));
+    } else if (ch == KEY_RIGHT || ch == 'd' || ch == 'D') {
+      // tecla derecha
+      input_stamp(w);
+      w.held_key.store(1);
+      w.move_right = true;
+      w.move_left = false;
+      timer_schedule(w, w.movement_timer, movement_timeout,
+                     timer_ticks(MOVEMENT_TIMEOUT_MS));
+    } else if (ch == ' ' || ch == 'k' || ch == 'K') {
+      input_stamp(w);
+      w.want_fire = true;
+    } else if (ch == KEY_F(5)) {
+      quick_save(w);
+    } else if (ch == KEY_F(9)) {
+      quick_load(w);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_INTERVAL_MS));
+  }
+}
+
+/**
+ * Bucle de actualización principal del juego
+ * Maneja el movimiento del jugador y disparos
+ */
+void player_update_step(GameWorld &w) {
+  TraceSpan span("player_update_step", "sistema");
+  float fire_x;
+  int fire_y;
+  {
+    TracedLock lock(w.game_state_mutex, "game_state_mutex");
+    w.prev_ship_fx = w.ship_fx;
+    // Flag de movimiento
+    if (w.move_left.load()) {
+      w.ship_fx =
+          std::max(1.0f, w.ship_fx - PLAYER_MOVEMENT_SPEED * tick_scale);
+      w.ship_x = static_cast<int>(std::round(w.ship_fx));
+    }
+    if (w.move_right.load()) {
+      w.ship_fx = std::min(static_cast<float>(w.screen_w - 2),
+                           w.ship_fx + PLAYER_MOVEMENT_SPEED * tick_scale);
+      w.ship_x = static_cast<int>(std::round(w.ship_fx));
+    }
+    fire_x = w.ship_fx;
+    fire_y = w.ship_y - 1;
+    // Las teclas leídas hasta acá quedan reflejadas en este tick
+    if (w.input_key_us.load(std::memory_order_relaxed)) {
+      long long key_us = w.input_key_us.exchange(0);
+      if (key_us && w.input_applied_key_us == 0) {
+        w.input_applied_key_us = key_us;
+        w.input_applied_us = now_us();
       }
     }
+  }
+  // Solicitud de disparo; bullet_mutex va antes que game_state_mutex, así que
+  // se toma recién al soltar el otro
+  if (w.want_fire.load()) {
+    TracedLock bullet_lock(w.bullet_mutex, "bullet_mutex");
+    for (int i = 0; i < MAX_BULLETS; i++)
+      if (!w.bullets[i].active) {
+        w.bullets[i].active = true;
+        w.bullets[i].x = fire_x;
+        w.bullets[i].y = fire_y;
+        w.bullets[i].prev_y = w.bullets[i].y;
+        if (w.telemetry_enabled)
+          telemetry_event(w, TEL_SRC_UPDATE, TEL_SHOT,
+                          count_active(w.bullets));
+        break;
+      }
+    w.want_fire = false;
+  }
+  w.sim_ticks.fetch_add(1, std::memory_order_relaxed);
+}
 
-    tick_counter++;
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+void update_loop(GameWorld &w) {
+  TraceThread trace_thread("nave");
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    player_update_step(w);
+    w.ship_tick_ms = now_ms();
+    timer_wheel_advance(w);
+    pacer.wait();
   }
-  return nullptr;
 }
 
 /**
- * Hilo 5: Controlador de disparos enemigos
- * Maneja los disparos aleatorios por parte de los enemigos
+ * Avanza un tick de simulación (UPDATE_INTERVAL_MS) en un solo hilo,
+ * ejecutando cada sistema con la misma cadencia que tiene su hilo.
  */
-void *enemy_shooting_controller_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    {
-      std::lock_guard<std::mutex> lock(enemy_mutex);
-      for (int e = 0; e < MAX_ENEMIES; e++) {
-        if (enemies[e].alive) {
-          if ((std::rand() % ENEMY_SHOOTING_DENOMINATOR) <
-              ENEMY_SHOOTING_PROBABILITY) {
-            for (int b = 0; b < MAX_BULLETS; b++) {
-              if (!ebullets[b].active) {
-                ebullets[b].active = true;
-                ebullets[b].x = enemies[e].x + ENEMY_W / 2.0f;
-                ebullets[b].y = enemies[e].y + ENEMY_H;
-                break;
-              }
-            }
-          }
-        }
+void simulate_tick(GameWorld &w, long long tick) {
+  player_update_step(w);
+  player_bullet_step(w);
+  enemy_bullet_step(w);
+  player_bullet_collision_step(w);
+  enemy_movement_step(w);
+  if (tick % 2 == 0)
+    enemy_shooting_step(w);
+  enemy_bullet_collision_step(w);
+  player_bullet_collision_step(w);
+  if (tick % 3 == 0)
+    level_completion_step(w);
+  timer_wheel_advance(w);
+}
+
+/**
+ * Piloto automático
+ * Controla move_left/move_right/want_fire igual que input_loop(): apunta a
+ * la columna del enemigo más cercano y esquiva las balas enemigas simulando los
+ * próximos ticks del estado actual.
+ */
+constexpr int AUTOPILOT_LOOKAHEAD_TICKS = 12;
+constexpr int AUTOPILOT_FIRE_COOLDOWN_TICKS = 4;
+constexpr long long HEADLESS_MAX_TICKS_PER_GAME = 200000;
+
+// Rectángulo de la nave dibujada con una columna de margen: más conservador
+// que la máscara de enemy_bullet_collision_step()
+static inline bool ship_hit_by(float ship_center, int sy, int screen_w, int bx,
+                               int by) {
+  int sx = static_cast<int>(std::round(ship_center));
+  int left = ship_draw_x(sx, screen_w);
+  return bx >= left - 1 && bx <= left + SHIP_W && by >= sy &&
+         by <= sy + SHIP_H - 1;
+}
+
+// Primer tick en que la nave sería alcanzada moviéndose en dir, o INT_MAX
+static int autopilot_first_hit(GameWorld &w, float sx, int sy, int dir,
+                               const EnemyBullet *eb) {
+  for (int k = 1; k <= AUTOPILOT_LOOKAHEAD_TICKS; k++) {
+    float pos = sx + dir * k * PLAYER_MOVEMENT_SPEED * tick_scale;
+    pos = std::max(1.0f, std::min(static_cast<float>(w.screen_w - 2), pos));
+    for (int b = 0; b < MAX_BULLETS; b++) {
+      if (!eb[b].active)
+        continue;
+      int bx = static_cast<int>(std::round(eb[b].x));
+      int by = static_cast<int>(
+          std::round(eb[b].y + k * ENEMY_BULLET_SPEED * tick_scale));
+      if (ship_hit_by(pos, sy, w.screen_w, bx, by))
+        return k;
+    }
+  }
+  return INT_MAX;
+}
+
+void autopilot_step(GameWorld &w) {
+  TraceSpan span("autopilot_step", "sistema");
+  float sx;
+  int sy;
+  {
+    TracedLock lock(w.game_state_mutex, "game_state_mutex");
+    sx = w.ship_fx;
+    sy = w.ship_y;
+  }
+
+  float target = -1.0f;
+  {
+    TracedLock lock(w.enemy_mutex, "enemy_mutex");
+    float best = 1e9f;
+    for (int e = 0; e < MAX_ENEMIES; e++) {
+      if (!w.enemies[e].alive)
+        continue;
+      float cx = enemy_x(w, w.enemies[e]) + ENEMY_W / 2;
+      float d = std::fabs(cx - sx);
+      if (d < best) {
+        best = d;
+        target = cx;
       }
     }
-    std::this_thread::sleep_for(
-        std::chrono::milliseconds(UPDATE_INTERVAL_MS * 2));
   }
-  return nullptr;
+
+  EnemyBullet eb[MAX_BULLETS];
+  {
+    TracedLock lock(w.bullet_mutex, "bullet_mutex");
+    std::memcpy(eb, w.ebullets, sizeof(eb));
+  }
+
+  int want_dir = 0;
+  if (target >= 0 &&
+      std::fabs(target - sx) > PLAYER_MOVEMENT_SPEED * tick_scale / 2)
+    want_dir = target < sx ? -1 : 1;
+
+  // Preferir la dirección deseada; si ninguna es segura, la que más tarde
+  // reciba un impacto.
+  int order[3] = {want_dir, 0, -want_dir};
+  if (want_dir == 0) {
+    order[1] = -1;
+    order[2] = 1;
+  }
+  int chosen = want_dir;
+  int best_hit = -1;
+  for (int dir : order) {
+    int hit = autopilot_first_hit(w, sx, sy, dir, eb);
+    if (hit > best_hit) {
+      best_hit = hit;
+      chosen = dir;
+    }
+    if (hit == INT_MAX)
+      break;
+  }
+
+  w.move_left = chosen < 0;
+  w.move_right = chosen > 0;
+
+  if (w.autopilot_fire_cooldown > 0)
+    w.autopilot_fire_cooldown--;
+  if (target >= 0 && std::fabs(target - sx) <= 1.5f &&
+      w.autopilot_fire_cooldown == 0) {
+    w.want_fire = true;
+    w.autopilot_fire_cooldown = AUTOPILOT_FIRE_COOLDOWN_TICKS;
+  }
+}
+
+void autopilot_loop(GameWorld &w) {
+  TraceThread trace_thread("piloto");
+  w.autopilot_fire_cooldown = 0;
+  TickPacer pacer(opt_tick_ms, &w.pause);
+  while (w.game_running.load()) {
+    autopilot_step(w);
+    pacer.wait();
+  }
+}
+
+// Resultado de una partida jugada por el piloto automático
+struct GameResult {
+  int score = 0;
+  int groups = 0; // grupos completados
+  bool won = false;
+  bool timed_out = false;
+  long long ticks = 0;
+};
+
+// Resultados acumulados; en el modo por lotes varios hilos registran a la vez
+struct AutopilotStats {
+  std::mutex mutex;
+  int games = 0;
+  int wins = 0;
+  int losses = 0;
+  int timeouts = 0;
+  std::vector<int> scores;
+  long long groups = 0;
+  long long ticks = 0;
+  long long start_ms = 0;
+};
+static AutopilotStats autopilot_stats;
+
+static GameResult game_result(GameWorld &w, bool timed_out, long long ticks) {
+  GameResult r;
+  r.score = w.player_score;
+  r.groups = w.current_group;
+  r.won = !timed_out && w.game_completed;
+  r.timed_out = timed_out;
+  r.ticks = ticks;
+  return r;
+}
+
+static void autopilot_record_game(const GameResult &r) {
+  std::lock_guard<std::mutex> lock(autopilot_stats.mutex);
+  autopilot_stats.games++;
+  if (r.timed_out)
+    autopilot_stats.timeouts++;
+  else if (r.won)
+    autopilot_stats.wins++;
+  else
+    autopilot_stats.losses++;
+  autopilot_stats.scores.push_back(r.score);
+  autopilot_stats.groups += r.groups;
+  autopilot_stats.ticks += r.ticks;
+}
+
+static void autopilot_print_summary(FILE *out) {
+  AutopilotStats &st = autopilot_stats;
+  std::lock_guard<std::mutex> lock(st.mutex);
+  long long elapsed = std::max(1LL, now_ms() - st.start_ms);
+  std::fprintf(out,
+               "Piloto automático: %d juegos (%d victorias, %d derrotas, %d "
+               "por límite de ticks)\n",
+               st.games, st.wins, st.losses, st.timeouts);
+  std::fprintf(out, "Ticks: %lld en %.1f s (%.0f ticks/s, %.1f juegos/s)\n",
+               st.ticks, elapsed / 1000.0, st.ticks * 1000.0 / elapsed,
+               st.games * 1000.0 / elapsed);
+  if (st.scores.empty())
+    return;
+  std::vector<int> sorted = st.scores;
+  std::sort(sorted.begin(), sorted.end());
+  long long sum = 0;
+  for (int v : sorted)
+    sum += v;
+  std::fprintf(out, "Puntaje: min %d, promedio %.1f, mediana %d, max %d\n",
+               sorted.front(), static_cast<double>(sum) / sorted.size(),
+               sorted[sorted.size() / 2], sorted.back());
+  std::fprintf(out, "Grupos completados por juego: %.2f, tasa de victoria: "
+               "%.1f%%\n",
+               static_cast<double>(st.groups) / st.games,
+               100.0 * st.wins / st.games);
+  // Distribución por rangos de 100 puntos
+  constexpr int BUCKET = 100;
+  int nbuckets = sorted.back() / BUCKET + 1;
+  std::vector<int> hist(nbuckets, 0);
+  for (int v : sorted)
+    hist[v / BUCKET]++;
+  for (int i = 0; i < nbuckets; i++) {
+    if (hist[i] == 0)
+      continue;
+    int bar = static_cast<int>(40LL * hist[i] / st.games);
+    std::fprintf(out, "  %4d-%-4d %5d %s\n", i * BUCKET,
+                 i * BUCKET + BUCKET - 1, hist[i],
+                 std::string(std::max(1, bar), '#').c_str());
+  }
 }
 
 /**
- * Hilo 6: Detector de colisiones entre balas enemigas y jugador
- * Detecta cuando las balas enemigas atinan al jugador y aplica efecto visual
- * de daño
+ * Juega una partida completa con el piloto automático sin terminal: los
+ * sistemas se avanzan en un solo hilo, tick tras tick, lo más rápido posible.
  */
-void *enemy_bullet_collision_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    for (int b = 0; b < MAX_BULLETS; b++) {
-      if (ebullets[b].active) {
-        if (static_cast<int>(ebullets[b].y) >= ship_y) {
-          int bullet_x = static_cast<int>(std::round(ebullets[b].x));
-          int bullet_y = static_cast<int>(std::round(ebullets[b].y));
-          int ship_left = static_cast<int>(ship_x - SHIP_W / 2.0f);
-          int ship_right = ship_left + SHIP_W - 1;
-          int ship_top = ship_y;
-          int ship_bottom = ship_y + SHIP_H - 1;
-
-          if (bullet_x >= ship_left && bullet_x <= ship_right &&
-              bullet_y >= ship_top && bullet_y <= ship_bottom) {
-            ebullets[b].active = false;
-            {
-              std::lock_guard<std::mutex> lock(game_state_mutex);
-              player_lives -= 1;
-              player_hit = true;
-              damage_flash_start_ms = now_ms();
-              if (player_lives <= 0)
-                game_running = false;
-            }
-          } else if (bullet_y >= screen_h) {
-            ebullets[b].active = false;
-          }
-        }
-      }
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+static GameResult play_headless_game(GameWorld &w, int mode, uint32_t seed) {
+  init_game_state(w, opt_headless_w, opt_headless_h, seed);
+  init_game_mode(w, mode);
+  reset_level(w);
+  w.move_left = w.move_right = w.want_fire = false;
+  w.autopilot_fire_cooldown = 0;
+  long long tick = 0;
+  while (w.game_running.load() && tick < HEADLESS_MAX_TICKS_PER_GAME) {
+    autopilot_step(w);
+    simulate_tick(w, tick++);
   }
-  return nullptr;
+  bool timed_out = w.game_running.load();
+  w.game_running = false;
+  return game_result(w, timed_out, tick);
 }
 
 /**
- * Hilo 7: Verificador de completación de grupos
- * Verifica si todos los enemigos del grupo han sido eliminados y maneja el
- * progreso del juego
+ * Verificación de asignaciones (--alloc-check, ver make alloc-check): juega
+ * partidas sin interfaz componiendo un cuadro por tick y falla si algún tick
+ * o cuadro usa el heap. La primera partida es de calentamiento.
  */
-void *level_completion_checker_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    {
-      std::lock_guard<std::mutex> lock(enemy_mutex);
-      int enemies_remaining = 0;
-      for (int e = 0; e < MAX_ENEMIES; e++) {
-        if (enemies[e].alive) {
-          enemies_remaining = 1;
-          break;
-        }
-      }
-
-      if (!enemies_remaining && enemies_in_current_group == 0) {
-        {
-          std::lock_guard<std::mutex> lock(game_state_mutex);
-          current_group++;
-
-          // Verificar si el juego está completado
-          int total_enemies =
-              (game_mode == 1) ? MODE1_TOTAL_ENEMIES : MODE2_TOTAL_ENEMIES;
-          if (enemies_destroyed >= total_enemies) {
-            game_completed = true;
-            game_running = false;
-          } else if (current_group >= GROUPS_PER_MODE) {
-            // Si completamos todos los grupos pero no todos los enemigos
-            current_group = 0; // Reiniciar grupos si es necesario
-          }
+constexpr int ALLOC_CHECK_GAMES = 10;
 
-          cv_level_complete.notify_all();
-        }
-
-        if (game_running.load()) {
-          reset_level();
-        }
-      }
+static int run_alloc_check(uint32_t seed) {
+  if (!ALLOC_TRACKING) {
+    std::fprintf(stderr,
+                 "--alloc-check requiere compilar con -DGALAGA_ALLOC_TRACKING "
+                 "(make alloc-check)\n");
+    return 2;
+  }
+  std::unique_ptr<GameWorld> world(new GameWorld);
+  GameWorld &w = *world;
+  w.particles_enabled = true;
+  long long tick_allocs = 0, frame_allocs = 0, ticks = 0;
+  for (int g = 0; g <= ALLOC_CHECK_GAMES; g++) {
+    init_game_state(w, opt_headless_w, opt_headless_h, seed + g);
+    init_game_mode(w, opt_headless_mode);
+    reset_level(w);
+    particles_clear(w);
+    w.move_left = w.move_right = w.want_fire = false;
+    w.autopilot_fire_cooldown = 0;
+    long long tick = 0;
+    while (w.game_running.load() && tick < HEADLESS_MAX_TICKS_PER_GAME) {
+      long long before_tick = thread_heap_allocs();
+      autopilot_step(w);
+      simulate_tick(w, tick++);
+      long long before_frame = thread_heap_allocs();
+      compose_frame(w, frame_cur);
+      if (g == 0)
+        continue;
+      tick_allocs += before_frame - before_tick;
+      frame_allocs += thread_heap_allocs() - before_frame;
+      ticks++;
     }
-    std::this_thread::sleep_for(
-        std::chrono::milliseconds(UPDATE_INTERVAL_MS * 3));
+    w.game_running = false;
   }
-  return nullptr;
+  std::printf("Asignaciones en estado estable: %lld en %lld ticks, %lld en "
+              "%lld cuadros (%d partidas, semilla %u, modo %d)\n",
+              tick_allocs, ticks, frame_allocs, ticks, ALLOC_CHECK_GAMES, seed,
+              opt_headless_mode);
+  if (tick_allocs != 0 || frame_allocs != 0) {
+    std::fprintf(stderr, "FALLA: el juego usa el heap en estado estable\n");
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
 }
 
 /**
- * Hilo 8: Monitor de estado del juego
- * Monitorea el estado general del juego y ve si le quedan vidas al jugador.
+ * Benchmark de picadas (--bench-divers): enemigos en picada avanzados por
+ * milisegundo leyendo las tablas, comparado con evaluar la curva cada tick.
  */
-void *game_state_monitor_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    {
-      std::unique_lock<std::mutex> lock(game_state_mutex);
-      cv_game_state.wait_for(lock, std::chrono::milliseconds(100));
+constexpr int BENCH_DIVERS_DEFAULT = 512;
+constexpr int BENCH_DIVERS_MS = 500;
 
-      if (player_lives <= 0) {
-        game_running = false;
-        cv_game_state.notify_all();
-      }
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+static int run_dive_benchmark(int divers) {
+  std::vector<Enemy> pool(divers);
+  for (int i = 0; i < divers; i++) {
+    Enemy &e = pool[i];
+    e.alive = true;
+    // Origen en 0: el desplazamiento es el lugar en la formación
+    e.off_x = e.x = 10.0f + i % 60;
+    e.off_y = e.y = 2.0f + (i / 60) % 4;
+    e.dive_path = i % DIVE_PATH_COUNT;
+    e.dive_t = static_cast<float>(i % DIVE_PATH_STEPS);
+    e.dive_dir = i % 2 ? 1 : -1;
   }
-  return nullptr;
+  const float span = 12.0f, max_x = 78.0f;
+  float checksum = 0;
+  auto measure = [&](auto advance) {
+    long long updates = 0;
+    long long start = now_ms(), elapsed;
+    do {
+      for (Enemy &e : pool)
+        if (!advance(e))
+          e.dive_t = 0;
+      updates += divers;
+      elapsed = now_ms() - start;
+    } while (elapsed < BENCH_DIVERS_MS);
+    for (const Enemy &e : pool)
+      checksum += e.x + e.y;
+    return static_cast<double>(updates) / elapsed;
+  };
+
+  double lut = measure([&](Enemy &e) {
+    return advance_diver(e, e.off_x, e.off_y, span, max_x);
+  });
+  double curve = measure([&](Enemy &e) {
+    e.dive_t += tick_scale;
+    if (e.dive_t >= DIVE_PATH_STEPS)
+      return false;
+    DivePoint p = dive_path_eval(e.dive_path, e.dive_t / (DIVE_PATH_STEPS - 1));
+    e.x = std::min(max_x, std::max(1.0f, e.off_x + e.dive_dir * p.dx));
+    e.y = std::max(1.0f, e.off_y + p.dy * span);
+    return true;
+  });
+  std::printf("Picadas: %d enemigos, %d puntos por trayectoria\n", divers,
+              DIVE_PATH_STEPS);
+  std::printf("  tablas precalculadas: %.0f enemigos/ms\n", lut);
+  std::printf("  curva evaluada:       %.0f enemigos/ms (%.1fx más lento)\n",
+              curve, lut / std::max(1.0, curve));
+  std::printf("  (suma de control %.0f)\n", checksum);
+  return 0;
 }
 
 /**
- * Hilo 9: Gestor de puntuación
- * Maneja la puntuación y otorga vidas bonus
+ * Benchmark de guiones (--bench-scripts): N enemigos en picada, cada uno con
+ * su corrutina en un ScriptRunner, contra el mismo avance en un bucle
+ * directo; además, guiones de un solo tick lanzados y terminados en cada
+ * paso para medir el costo de crear y destruir marcos del pool.
  */
-void *score_manager_thread(void *arg) {
-  (void)arg;
-  int last_score = 0;
-  while (game_running.load()) {
-    {
-      std::lock_guard<std::mutex> lock(score_mutex);
-      if (player_score != last_score) {
-        last_score = player_score;
-        // Agregar vida bonus cada 300 puntos
-        if (player_score > 0 && player_score % 300 == 0) {
-          std::lock_guard<std::mutex> state_lock(game_state_mutex);
-          if (player_lives < 5)
-            player_lives++;
-        }
-      }
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+constexpr int BENCH_SCRIPTS_DEFAULT = 512;
+constexpr int BENCH_SCRIPTS_MS = 500;
+
+struct ScriptBench {
+  explicit ScriptBench(int capacity) : scripts(capacity) {}
+  ScriptRunner scripts;
+};
+
+static EnemyScript bench_dive_script(ScriptBench &, Enemy &en, float span,
+                                     float max_x) {
+  while (true) {
+    if (!advance_diver(en, en.off_x, en.off_y, span, max_x))
+      en.dive_t = 0;
+    co_await script_sleep(1);
   }
-  return nullptr;
+}
+
+static EnemyScript bench_short_script(ScriptBench &, Enemy &en, float span,
+                                      float max_x) {
+  advance_diver(en, en.off_x, en.off_y, span, max_x);
+  co_return;
+}
+
+static int run_script_benchmark(int n) {
+  std::vector<Enemy> pool(n);
+  for (int i = 0; i < n; i++) {
+    Enemy &e = pool[i];
+    e.alive = true;
+    e.off_x = e.x = 10.0f + i % 60;
+    e.off_y = e.y = 2.0f + (i / 60) % 4;
+    e.dive_path = i % DIVE_PATH_COUNT;
+    e.dive_t = static_cast<float>(i % DIVE_PATH_STEPS);
+    e.dive_dir = i % 2 ? 1 : -1;
+  }
+  const float span = 12.0f, max_x = 78.0f;
+  std::unique_ptr<ScriptBench> bench(new ScriptBench(n));
+  ScriptRunner &r = bench->scripts;
+  auto measure = [&](auto step) {
+    long long updates = 0;
+    long long start = now_ms(), elapsed;
+    do {
+      step();
+      updates += n;
+      elapsed = now_ms() - start;
+    } while (elapsed < BENCH_SCRIPTS_MS);
+    return static_cast<double>(updates) / elapsed;
+  };
+
+  double direct = measure([&]() {
+    for (Enemy &e : pool)
+      if (!advance_diver(e, e.off_x, e.off_y, span, max_x))
+        e.dive_t = 0;
+  });
+  for (Enemy &e : pool)
+    script_start(r, bench_dive_script(*bench, e, span, max_x), &e.alive);
+  double scripted = measure([&]() { script_runner_step(r); });
+  script_runner_clear(r);
+  double churn = measure([&]() {
+    for (Enemy &e : pool)
+      script_start(r, bench_short_script(*bench, e, span, max_x), &e.alive);
+    script_runner_step(r);
+  });
+  float checksum = 0;
+  for (const Enemy &e : pool)
+    checksum += e.x + e.y;
+
+  std::printf("Guiones: %d corrutinas, marco de %zu bytes en bloques de %zu\n",
+              n, r.pool.max_frame_bytes, SCRIPT_BLOCK_BYTES);
+  std::printf("  bucle directo:       %.0f enemigos/ms\n", direct);
+  std::printf("  corrutinas:          %.0f enemigos/ms (%.1fx más lento)\n",
+              scripted, direct / std::max(1.0, scripted));
+  std::printf("  crear y terminar:    %.0f guiones/ms\n", churn);
+  std::printf("  marcos en el heap:   %lld\n", r.pool.heap_frames);
+  std::printf("  (suma de control %.0f)\n", checksum);
+  return r.pool.heap_frames == 0 ? 0 : 1;
 }
 
 /**
- * Hilo 10: Gestor de efectos visuales
- * Maneja efectos visuales como el parpadeo de daño
+ * Benchmark de intercepción (--bench-intercept): N balas de cada lado
+ * repartidas en un campo de N/4 columnas, resueltas con el barrido ordenado
+ * y con el doble bucle directo. Ambos deben anular los mismos pares.
  */
-void *visual_effects_manager_thread(void *arg) {
-  (void)arg;
-  while (game_running.load()) {
-    if (player_hit.load()) {
-      if (now_ms() - damage_flash_start_ms >= DAMAGE_FLASH_DURATION_MS) {
-        player_hit = false;
-      }
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+constexpr int BENCH_INTERCEPT_DEFAULT = 4096;
+constexpr int BENCH_INTERCEPT_MS = 500;
+
+static int run_intercept_benchmark(int n) {
+  WorldData rng;
+  world_seed(rng, opt_seed ? opt_seed : 1);
+  int cols = std::max(80, n / 4), rows = 200;
+  std::vector<Bullet> pb0(n), pb(n);
+  std::vector<EnemyBullet> eb0(n), eb(n);
+  for (int i = 0; i < n; i++) {
+    pb0[i].active = eb0[i].active = true;
+    pb0[i].x = static_cast<float>(world_rand(rng) % cols);
+    pb0[i].y = static_cast<float>(world_rand(rng) % rows);
+    pb0[i].prev_y = pb0[i].y + PLAYER_BULLET_SPEED;
+    eb0[i].x = static_cast<float>(world_rand(rng) % cols);
+    eb0[i].y = static_cast<float>(world_rand(rng) % rows);
+    eb0[i].prev_y = eb0[i].y - ENEMY_BULLET_SPEED;
   }
-  return nullptr;
+  std::vector<SweepKey> pk(n), ek(n);
+  auto measure = [&](auto resolve, int &hits) {
+    long long rounds = 0;
+    long long start = now_ms(), elapsed;
+    do {
+      pb = pb0;
+      eb = eb0;
+      hits = resolve();
+      rounds++;
+      elapsed = now_ms() - start;
+    } while (elapsed < BENCH_INTERCEPT_MS);
+    return static_cast<double>(elapsed) * 1000.0 / rounds;
+  };
+
+  int sweep_hits = 0, brute_hits = 0;
+  double sweep_us = measure(
+      [&]() {
+        return intercept_sweep(pb.data(), n, eb.data(), n, pk.data(),
+                               ek.data(), bullets_cross,
+                               [](const Bullet &, const EnemyBullet &) {});
+      },
+      sweep_hits);
+  double brute_us = measure(
+      [&]() {
+        int hits = 0;
+        for (int i = 0; i < n; i++)
+          for (int j = 0; j < n && pb[i].active; j++)
+            if (eb[j].active &&
+                std::round(pb[i].x) == std::round(eb[j].x) &&
+                bullets_cross(pb[i], eb[j])) {
+              pb[i].active = eb[j].active = false;
+              hits++;
+            }
+        return hits;
+      },
+      brute_hits);
+  std::printf("Intercepción: %d balas del jugador, %d enemigas, %d columnas\n",
+              n, n, cols);
+  std::printf("  barrido ordenado: %.1f us por paso, %d pares\n", sweep_us,
+              sweep_hits);
+  std::printf("  doble bucle:      %.1f us por paso, %d pares (%.1fx más "
+              "lento)\n",
+              brute_us, brute_hits, brute_us / std::max(0.001, sweep_us));
+  if (sweep_hits != brute_hits) {
+    std::printf("ERROR: los métodos no coinciden\n");
+    return 1;
+  }
+  return 0;
 }
 
 /**
- * Dibuja la pantalla del juego con todos los elementos
+ * Benchmark de punta a punta en una pseudoterminal (--pty-bench): ejecuta
+ * este mismo binario con el piloto automático bajo forkpty() en cada tamaño
+ * pedido, le envía las teclas del menú y mide del lado del maestro los bytes
+ * por segundo, el ritmo de cuadros y el tiempo de CPU del juego. A diferencia
+ * de los otros benchmarks incluye ncurses y la salida a la terminal.
  */
-void draw_screen() {
-  // Capturar estado bajo lock
-  struct GameSnapshot {
-    int score;
-    int lives;
-    int mode;
-    int group;
-    int enemies_destroyed;
-    int ship_x;
-    int ship_y;
-    bool is_hit;
-    std::vector<std::pair<int, int>> player_bullets;
-    std::vector<std::pair<int, int>> enemy_bullets;
-    std::vector<std::pair<int, int>> alive_enemies;
-  } snapshot;
+constexpr const char *PTY_BENCH_DEFAULT_SIZES = "80x24,300x100";
+constexpr int PTY_BENCH_WARMUP_MS = 1000;
+constexpr int PTY_BENCH_QUIT_TRIES = 10;
+// Lecturas separadas por menos de esto son parte del mismo cuadro
+constexpr long long PTY_FRAME_GAP_US = 3000;
 
-  {
-    std::lock_guard<std::mutex> lock(game_state_mutex);
-    snapshot.score = player_score;
-    snapshot.lives = player_lives;
-    snapshot.mode = game_mode;
-    snapshot.group = current_group + 1;
-    snapshot.enemies_destroyed = enemies_destroyed;
-    snapshot.ship_x = ship_x;
-    snapshot.ship_y = ship_y;
+struct PtyKey {
+  int at_ms;
+  const char *keys;
+};
+// Menú: Jugar, modo 1
+constexpr PtyKey PTY_BENCH_SCRIPT[] = {{300, "\r"}, {600, "\r"}};
 
-    snapshot.is_hit = player_hit.load();
+// Tiempo de CPU (usuario + sistema) de todos los hilos de pid, en ms
+static double process_cpu_ms(pid_t pid) {
+  char path[64], buf[1024];
+  std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0)
+    return 0;
+  buf[n] = '\0';
+  // El nombre del proceso puede tener espacios: se sigue desde el último ')'
+  const char *p = std::strrchr(buf, ')');
+  unsigned long utime = 0, stime = 0;
+  if (!p || std::sscanf(p + 2,
+                        "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                        &utime, &stime) != 2)
+    return 0;
+  return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
 
-    for (int i = 0; i < MAX_BULLETS; i++)
-      if (bullets[i].active)
-        snapshot.player_bullets.emplace_back(
-            static_cast<int>(std::round(bullets[i].x)),
-            static_cast<int>(std::round(bullets[i].y)));
-    for (int i = 0; i < MAX_BULLETS; i++)
-      if (ebullets[i].active)
-        snapshot.enemy_bullets.emplace_back(
-            static_cast<int>(std::round(ebullets[i].x)),
-            static_cast<int>(std::round(ebullets[i].y)));
-    for (int i = 0; i < MAX_ENEMIES; i++)
-      if (enemies[i].alive)
-        snapshot.alive_enemies.emplace_back(
-            static_cast<int>(std::round(enemies[i].x)),
-            static_cast<int>(std::round(enemies[i].y)));
+static double percentile_ms(const std::vector<long long> &sorted_us,
+                            double p) {
+  if (sorted_us.empty())
+    return 0;
+  size_t i = std::min(sorted_us.size() - 1,
+                      static_cast<size_t>(p * sorted_us.size()));
+  return sorted_us[i] / 1000.0;
+}
+
+static bool pty_bench_run(char *const *child_argv, int cols, int rows,
+                          int seconds) {
+  struct winsize ws = {};
+  ws.ws_col = static_cast<unsigned short>(cols);
+  ws.ws_row = static_cast<unsigned short>(rows);
+  int fd;
+  pid_t pid = forkpty(&fd, nullptr, nullptr, &ws);
+  if (pid < 0) {
+    std::perror("forkpty");
+    return false;
+  }
+  if (pid == 0) {
+    setenv("TERM", "xterm-256color", 1);
+    execv("/proc/self/exe", child_argv);
+    _exit(127);
   }
 
-  // Dibujar en buffer trasero
-  if (!backwin) {
-    clear();
-    int hud_left = 2;
-    int hud_best = screen_w / 2 - 12;
-    int hud_lives = screen_w / 2 + 6;
-    int hud_mode = screen_w - 15;
-    if (hud_best < hud_left + 12)
-      hud_best = hud_left + 12;
-    if (hud_lives <= hud_best + 10)
-      hud_lives = hud_best + 12;
-    if (hud_mode <= hud_lives + 8)
-      hud_mode = hud_lives + 10;
-    if (hud_mode >= screen_w - 1)
-      hud_mode = std::max(hud_lives + 6, screen_w - 15);
-    mvprintw(0, hud_left, "Puntaje: %d", snapshot.score);
-    mvprintw(0, hud_best, "Mejor: %d", saved_highscore);
-    mvprintw(0, hud_lives, "Vidas: %d", snapshot.lives);
-    mvprintw(0, hud_mode, "Modo %d G%d", snapshot.mode, snapshot.group);
-    int sx = snapshot.ship_x - SHIP_W / 2;
-    if (sx < 0)
-      sx = 0;
-    if (sx + SHIP_W >= screen_w)
-      sx = screen_w - SHIP_W;
-
-    // Aplicar efecto visual de daño (parpadeo rojo)
-    if (snapshot.is_hit && has_colors())
-      attron(COLOR_PAIR(2));
-    else if (has_colors())
-      attron(COLOR_PAIR(1));
-
-    for (int r = 0; r < SHIP_H; r++) {
-      mvaddnstr(snapshot.ship_y + r, sx, SHIP_ART[r], SHIP_W);
-    }
-    if (has_colors())
-      attroff(COLOR_PAIR(1) | COLOR_PAIR(2));
-
-    if (has_colors())
-      attron(COLOR_PAIR(3));
-    for (auto &p : snapshot.player_bullets)
-      mvaddch(p.second, p.first, '|');
-    for (auto &p : snapshot.enemy_bullets)
-      mvaddch(p.second, p.first, '!');
-    if (has_colors())
-      attroff(COLOR_PAIR(3));
-    for (auto &en : snapshot.alive_enemies) {
-      int ex = en.first - 1;
-      int ey = en.second;
-      if (ex < 0)
-        ex = 0;
-      if (ex + ENEMY_W >= screen_w)
-        ex = screen_w - ENEMY_W;
-      if (has_colors())
-        attron(COLOR_PAIR(2));
-      const char **art = enemy_art_for_level(snapshot.mode);
-      for (int r = 0; r < ENEMY_H; r++) {
-        mvaddnstr(ey + r, ex, art[r], ENEMY_W);
+  long long start = now_us();
+  long long script_end_ms = 0;
+  for (const PtyKey &k : PTY_BENCH_SCRIPT)
+    script_end_ms = std::max<long long>(script_end_ms, k.at_ms);
+  long long window_start = start + (script_end_ms + PTY_BENCH_WARMUP_MS) * 1000;
+  long long window_end = window_start + seconds * 1000000LL;
+  size_t next_key = 0;
+  int quit_tries = 0;
+  long long next_quit = window_end;
+  double cpu_start = 0, cpu_end = 0;
+  bool window_open = false;
+
+  long long bytes = 0, frames = 0, last_read = 0, frame_start = 0;
+  std::vector<long long> intervals;
+  char buf[65536];
+  while (true) {
+    long long t = now_us();
+    if (next_key < std::size(PTY_BENCH_SCRIPT) &&
+        t - start >= PTY_BENCH_SCRIPT[next_key].at_ms * 1000LL) {
+      const char *k = PTY_BENCH_SCRIPT[next_key++].keys;
+      if (write(fd, k, std::strlen(k)) < 0)
+        break;
+    }
+    if (!window_open && t >= window_start) {
+      window_open = true;
+      cpu_start = process_cpu_ms(pid);
+    }
+    if (t >= next_quit) {
+      // Fin de la ventana: salir del juego y de los menús con 'q'
+      if (quit_tries == 0)
+        cpu_end = process_cpu_ms(pid);
+      if (quit_tries++ == PTY_BENCH_QUIT_TRIES) {
+        kill(pid, SIGKILL);
+        break;
       }
-      if (has_colors())
-        attroff(COLOR_PAIR(2));
+      if (write(fd, "q", 1) < 0)
+        break;
+      next_quit = t + 300000;
     }
-    refresh();
-    return;
-  }
-
-  werase(backwin);
-  // Calcular posiciones del HUD
-  int bhud_left = 2;
-  int bhud_best = screen_w / 2 - 12;
-  int bhud_lives = screen_w / 2 + 6;
-  int bhud_mode = screen_w - 15;
-  if (bhud_best < bhud_left + 12)
-    bhud_best = bhud_left + 12;
-  if (bhud_lives <= bhud_best + 10)
-    bhud_lives = bhud_best + 12;
-  if (bhud_mode <= bhud_lives + 8)
-    bhud_mode = bhud_lives + 10;
-  if (bhud_mode >= screen_w - 1)
-    bhud_mode = std::max(bhud_lives + 6, screen_w - 15);
-  mvwprintw(backwin, 0, bhud_left, "Puntaje: %d", snapshot.score);
-  mvwprintw(backwin, 0, bhud_best, "Mejor: %d", saved_highscore);
-  mvwprintw(backwin, 0, bhud_lives, "Vidas: %d", snapshot.lives);
-  mvwprintw(backwin, 0, bhud_mode, "Modo %d G%d", snapshot.mode,
-            snapshot.group);
 
-  // Centrar nave
-  int ship_screen_x = snapshot.ship_x - SHIP_W / 2;
-  if (ship_screen_x < 0)
-    ship_screen_x = 0;
-  if (ship_screen_x + SHIP_W >= screen_w)
-    ship_screen_x = screen_w - SHIP_W;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 5) <= 0)
+      continue;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+      break; // EIO: el juego terminó y cerró la terminal
+    t = now_us();
+    if (t >= window_start && t < window_end) {
+      bytes += n;
+      if (t - last_read > PTY_FRAME_GAP_US) {
+        if (frame_start)
+          intervals.push_back(t - frame_start);
+        frame_start = t;
+        frames++;
+      }
+    }
+    last_read = t;
+  }
+  close(fd);
+  int status = 0;
+  struct rusage ru = {};
+  wait4(pid, &status, 0, &ru);
+  if (quit_tries == 0) {
+    std::fprintf(stderr, "PTY %dx%d: el juego terminó antes de tiempo\n", cols,
+                 rows);
+    return false;
+  }
 
-  // Aplicar efecto visual de daño (parpadeo rojo)
-  if (snapshot.is_hit && has_colors())
-    wattron(backwin, COLOR_PAIR(2));
-  else if (has_colors())
-    wattron(backwin, COLOR_PAIR(1));
-
-  for (int r = 0; r < SHIP_H; r++) {
-    mvwaddnstr(backwin, snapshot.ship_y + r, ship_screen_x, SHIP_ART[r],
-               SHIP_W);
-  }
-  if (has_colors())
-    wattroff(backwin, COLOR_PAIR(1) | COLOR_PAIR(2));
-
-  if (has_colors())
-    wattron(backwin, COLOR_PAIR(3));
-  for (auto &p : snapshot.player_bullets)
-    mvwaddch(backwin, p.second, p.first, '|');
-  for (auto &p : snapshot.enemy_bullets)
-    mvwaddch(backwin, p.second, p.first, '!');
-  if (has_colors())
-    wattroff(backwin, COLOR_PAIR(3));
-
-  for (auto &en : snapshot.alive_enemies) {
-    int ex = en.first - 1;
-    int ey = en.second;
-    if (ex < 0)
-      ex = 0;
-    if (ex + ENEMY_W >= screen_w)
-      ex = screen_w - ENEMY_W;
-    if (has_colors())
-      wattron(backwin, COLOR_PAIR(2));
-    const char **art = enemy_art_for_level(snapshot.mode);
-    for (int r = 0; r < ENEMY_H; r++) {
-      mvwaddnstr(backwin, ey + r, ex, art[r], ENEMY_W);
-    }
-    if (has_colors())
-      wattroff(backwin, COLOR_PAIR(2));
-  }
-
-  // Pasar del buffer fuera de pantalla a la pantalla real
-  wnoutrefresh(backwin);
-  doupdate();
+  double window_s = seconds;
+  double cpu_ms = cpu_end - cpu_start;
+  double total_cpu_ms = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+                        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+  std::sort(intervals.begin(), intervals.end());
+  std::printf("PTY %dx%d: %lld cuadros en %.0f s (%.1f/s), %.0f bytes/s, "
+              "%lld bytes/cuadro\n",
+              cols, rows, frames, window_s, frames / window_s, bytes / window_s,
+              frames ? bytes / frames : 0);
+  std::printf("  intervalo entre cuadros: p50 %.1f ms, p95 %.1f ms, p99 %.1f "
+              "ms, máx %.1f ms\n",
+              percentile_ms(intervals, 0.50), percentile_ms(intervals, 0.95),
+              percentile_ms(intervals, 0.99), percentile_ms(intervals, 1.0));
+  std::printf("  CPU del juego: %.0f ms en la ventana (%.1f%% de un núcleo), "
+              "%.0f ms en total\n",
+              cpu_ms, cpu_ms / (window_s * 10.0), total_cpu_ms);
+  return true;
 }
 
-/**
- * Bucle de entrada de teclado
- * Maneja el input del usuario
- */
-void input_loop() {
-  int ch;
-  nodelay(stdscr, TRUE);
-  keypad(stdscr, TRUE);
-  while (game_running.load()) {
-    ch = getch();
-    if (ch == ERR) {
-      int hk = held_key.load();
-      if (hk != 0) {
-        long long elapsed = now_ms() - last_move_ms.load();
-        if (elapsed > MOVEMENT_TIMEOUT_MS) {
-          held_key.store(0);
-          move_left = false;
-          move_right = false;
-        }
-      }
-      std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_INTERVAL_MS));
+static int run_pty_bench(int argc, char **argv) {
+  // El juego recibe los mismos argumentos, sin los del benchmark
+  std::vector<char *> args = {argv[0]};
+  bool has_autopilot = false, has_seed = false, has_leaderboard = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--pty-bench") == 0) {
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        i++;
       continue;
     }
+    if (std::strcmp(argv[i], "--pty-seconds") == 0) {
+      i++;
+      continue;
+    }
+    has_autopilot |= std::strcmp(argv[i], "--autopilot") == 0;
+    has_seed |= std::strcmp(argv[i], "--seed") == 0;
+    has_leaderboard |= std::strcmp(argv[i], "--leaderboard") == 0;
+    args.push_back(argv[i]);
+  }
+  char autopilot[] = "--autopilot", seed_opt[] = "--seed", seed[] = "1";
+  char lb_opt[] = "--leaderboard", lb_path[64];
+  std::snprintf(lb_path, sizeof(lb_path), "/tmp/galaga_pty_bench_%d.db",
+                static_cast<int>(getpid()));
+  if (!has_autopilot)
+    args.push_back(autopilot);
+  if (!has_seed) {
+    args.push_back(seed_opt);
+    args.push_back(seed);
+  }
+  if (!has_leaderboard) {
+    args.push_back(lb_opt);
+    args.push_back(lb_path);
+  }
+  args.push_back(nullptr);
 
-    // Terminar juego
-    if (ch == 'q' || ch == 'Q') {
-      game_running = false;
-    } else if (ch == KEY_LEFT || ch == 'a' || ch == 'A') {
-      // tecla izquierda
-      held_key.store(-1);
-      move_left = true;
-      move_right = false;
-      last_move_ms.store(now_ms());
-    } else if (ch == KEY_RIGHT || ch == 'd' || ch == 'D') {
-      // tecla derecha
-      held_key.store(1);
-      move_right = true;
-      move_left = false;
-      last_move_ms.store(now_ms());
-    } else if (ch == ' ' || ch == 'k' || ch == 'K') {
-      want_fire = true;
+  std::string sizes = opt_pty_bench_sizes;
+  bool ok = true;
+  size_t pos = 0;
+  while (pos <= sizes.size()) {
+    size_t comma = std::min(sizes.find(',', pos), sizes.size());
+    int cols, rows;
+    if (std::sscanf(sizes.c_str() + pos, "%dx%d", &cols, &rows) != 2 ||
+        cols < 20 || rows < 10 || cols > MAX_FRAME_W || rows > MAX_FRAME_H) {
+      std::fprintf(stderr, "Tamaño inválido: %s\n",
+                   sizes.substr(pos, comma - pos).c_str());
+      return 1;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_INTERVAL_MS));
+    ok &= pty_bench_run(args.data(), cols, rows, opt_pty_seconds);
+    pos = comma + 1;
   }
+  unlink(lb_path);
+  return ok ? 0 : 1;
 }
 
 /**
- * Bucle de actualización principal del juego
- * Maneja el movimiento del jugador y disparos
+ * Modo por lotes: reparte `games` partidas con semillas seed, seed+1, ...
+ * entre `jobs` hilos, cada uno con su propio GameWorld.
  */
-void update_loop() {
-  while (game_running.load()) {
-    {
-      std::lock_guard<std::mutex> lock(game_state_mutex);
-      // Flag de movimiento
-      if (move_left.load()) {
-        ship_fx = std::max(1.0f, ship_fx - PLAYER_MOVEMENT_SPEED);
-        ship_x = static_cast<int>(std::round(ship_fx));
-      }
-      if (move_right.load()) {
-        ship_fx = std::min(static_cast<float>(screen_w - 2),
-                           ship_fx + PLAYER_MOVEMENT_SPEED);
-        ship_x = static_cast<int>(std::round(ship_fx));
-      }
-      // Solicitud de disparo
-      if (want_fire.load()) {
-        std::lock_guard<std::mutex> bullet_lock(bullet_mutex);
-        for (int i = 0; i < MAX_BULLETS; i++)
-          if (!bullets[i].active) {
-            bullets[i].active = true;
-            bullets[i].x = ship_fx;
-            bullets[i].y = ship_y - 1;
-            break;
-          }
-        want_fire = false;
+static int run_batch(int games, int jobs, uint32_t seed) {
+  autopilot_stats.start_ms = now_ms();
+  std::atomic<int> next_game{0};
+  auto worker = [&]() {
+    GameWorld w;
+    for (int g = next_game++; g < games; g = next_game++)
+      autopilot_record_game(
+          play_headless_game(w, opt_headless_mode, seed + g));
+  };
+  std::vector<std::thread> pool;
+  for (int j = 0; j < jobs; j++)
+    pool.emplace_back(worker);
+  for (auto &t : pool)
+    t.join();
+  std::printf("Lote: %d juegos, %d hilos, semilla %u, modo %d, %dx%d\n", games,
+              jobs, seed, opt_headless_mode, opt_headless_w, opt_headless_h);
+  autopilot_print_summary(stdout);
+  return 0;
+}
+
+/**
+ * Resumen de telemetría (--telemetry-summary ARCHIVO|DIR...)
+ * Cada archivo se lee de una vez y se agrega en un hilo del grupo (--jobs);
+ * los eventos de una sesión no vienen ordenados entre hilos productores, así
+ * que se agrupan por partida y grupo antes de calcular tiempos.
+ */
+struct TelGroupTotals {
+  long long started = 0, cleared = 0, damage = 0, clear_ms = 0;
+};
+
+struct TelSummary {
+  long long sessions = 0, bad_files = 0, games = 0, wins = 0;
+  long long shots = 0, kills = 0, damage = 0, dropped = 0, score_sum = 0;
+  long long max_bullets_sum = 0; // suma del máximo de cada partida
+  int max_bullets = 0, max_enemy_bullets = 0;
+  TelGroupTotals groups[GROUPS_PER_MODE];
+
+  void merge(const TelSummary &o) {
+    sessions += o.sessions;
+    bad_files += o.bad_files;
+    games += o.games;
+    wins += o.wins;
+    shots += o.shots;
+    kills += o.kills;
+    damage += o.damage;
+    dropped += o.dropped;
+    score_sum += o.score_sum;
+    max_bullets_sum += o.max_bullets_sum;
+    max_bullets = std::max(max_bullets, o.max_bullets);
+    max_enemy_bullets = std::max(max_enemy_bullets, o.max_enemy_bullets);
+    for (int g = 0; g < GROUPS_PER_MODE; g++) {
+      groups[g].started += o.groups[g].started;
+      groups[g].cleared += o.groups[g].cleared;
+      groups[g].damage += o.groups[g].damage;
+      groups[g].clear_ms += o.groups[g].clear_ms;
+    }
+  }
+};
+
+struct TelGame {
+  bool ended = false;
+  int max_bullets = 0;
+  long long start_ms[GROUPS_PER_MODE], clear_ms[GROUPS_PER_MODE];
+  TelGame() {
+    std::fill(start_ms, start_ms + GROUPS_PER_MODE, -1LL);
+    std::fill(clear_ms, clear_ms + GROUPS_PER_MODE, -1LL);
+  }
+};
+
+static bool telemetry_summarize_file(const char *path, TelSummary &s) {
+  FILE *f = std::fopen(path, "rb");
+  if (!f)
+    return false;
+  std::vector<unsigned char> data;
+  std::fseek(f, 0, SEEK_END);
+  long size = std::ftell(f);
+  std::fseek(f, 0, SEEK_SET);
+  if (size > 0) {
+    data.resize(static_cast<size_t>(size));
+    data.resize(std::fread(data.data(), 1, data.size(), f));
+  }
+  std::fclose(f);
+  TelHeader hdr;
+  if (data.size() < sizeof(hdr))
+    return false;
+  std::memcpy(&hdr, data.data(), sizeof(hdr));
+  if (std::memcmp(hdr.magic, TEL_MAGIC, sizeof(TEL_MAGIC)) != 0 ||
+      hdr.version != TEL_VERSION || hdr.event_size != sizeof(TelEvent))
+    return false;
+
+  size_t n = (data.size() - sizeof(hdr)) / sizeof(TelEvent);
+  std::vector<TelEvent> events(n);
+  std::memcpy(events.data(), data.data() + sizeof(hdr), n * sizeof(TelEvent));
+  std::vector<TelGame> games;
+  for (const TelEvent &e : events) {
+    if (e.type == TEL_DROPPED) {
+      s.dropped += e.a;
+      continue;
+    }
+    if (e.game >= games.size())
+      games.resize(e.game + 1u);
+    TelGame &g = games[e.game];
+    int grp = std::min<int>(e.group, GROUPS_PER_MODE - 1);
+    switch (e.type) {
+    case TEL_GAME_END:
+      g.ended = true;
+      s.wins += e.a != 0;
+      s.score_sum += e.b;
+      break;
+    case TEL_GROUP_START:
+      g.start_ms[grp] = e.t_ms;
+      s.groups[grp].started++;
+      break;
+    case TEL_GROUP_CLEAR:
+      g.clear_ms[grp] = e.t_ms;
+      break;
+    case TEL_SHOT:
+      s.shots++;
+      g.max_bullets = std::max(g.max_bullets, static_cast<int>(e.a));
+      break;
+    case TEL_ENEMY_SHOT:
+      s.max_enemy_bullets =
+          std::max(s.max_enemy_bullets, static_cast<int>(e.a));
+      break;
+    case TEL_KILL:
+      s.kills++;
+      break;
+    case TEL_DAMAGE:
+      s.damage++;
+      s.groups[grp].damage++;
+      break;
+    default:
+      break;
+    }
+  }
+  for (const TelGame &g : games) {
+    // Las partidas sin fin (proceso interrumpido) no cuentan como jugadas
+    if (!g.ended)
+      continue;
+    s.games++;
+    s.max_bullets = std::max(s.max_bullets, g.max_bullets);
+    s.max_bullets_sum += g.max_bullets;
+    for (int i = 0; i < GROUPS_PER_MODE; i++)
+      if (g.start_ms[i] >= 0 && g.clear_ms[i] >= g.start_ms[i]) {
+        s.groups[i].cleared++;
+        s.groups[i].clear_ms += g.clear_ms[i] - g.start_ms[i];
       }
+  }
+  s.sessions++;
+  return true;
+}
+
+static const char *const *opt_summary_paths = nullptr;
+static int opt_summary_count = -1; // >= 0 = --telemetry-summary
+
+static int run_telemetry_summary(const char *const *paths, int count,
+                                 int jobs) {
+  long long t0 = now_ms();
+  std::vector<std::string> files;
+  for (int i = 0; i < count; i++) {
+    DIR *dir = opendir(paths[i]);
+    if (!dir) {
+      files.emplace_back(paths[i]);
+      continue;
     }
+    while (dirent *ent = readdir(dir)) {
+      size_t len = std::strlen(ent->d_name);
+      if (len > 4 && std::strcmp(ent->d_name + len - 4, ".tlm") == 0)
+        files.push_back(std::string(paths[i]) + "/" + ent->d_name);
+    }
+    closedir(dir);
+  }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+  TelSummary total;
+  std::mutex total_mutex;
+  std::atomic<size_t> next_file{0};
+  auto worker = [&]() {
+    TelSummary local;
+    for (size_t i = next_file++; i < files.size(); i = next_file++)
+      if (!telemetry_summarize_file(files[i].c_str(), local))
+        local.bad_files++;
+    std::lock_guard<std::mutex> lock(total_mutex);
+    total.merge(local);
+  };
+  std::vector<std::thread> pool;
+  jobs = std::max(1, std::min<int>(jobs, static_cast<int>(files.size())));
+  for (int j = 0; j < jobs; j++)
+    pool.emplace_back(worker);
+  for (auto &t : pool)
+    t.join();
+
+  const TelSummary &s = total;
+  long long games = std::max(1LL, s.games);
+  std::printf("Telemetría: %lld sesiones (%lld archivos inválidos) en %lld "
+              "ms, %d hilos\n",
+              s.sessions, s.bad_files, now_ms() - t0, jobs);
+  std::printf("Partidas: %lld (%lld victorias), puntaje promedio %.1f, "
+              "eventos descartados %lld\n",
+              s.games, s.wins, static_cast<double>(s.score_sum) / games,
+              s.dropped);
+  std::printf("Disparos: %lld, impactos: %lld, precisión: %.1f%%\n", s.shots,
+              s.kills, s.shots ? 100.0 * s.kills / s.shots : 0.0);
+  std::printf("Balas simultáneas: jugador máx %d (promedio por partida %.1f), "
+              "enemigas máx %d\n",
+              s.max_bullets, static_cast<double>(s.max_bullets_sum) / games,
+              s.max_enemy_bullets);
+  std::printf("Daño recibido: %lld (%.2f por partida)\n", s.damage,
+              static_cast<double>(s.damage) / games);
+  std::printf("  Grupo  Jugados  Completados  Tiempo medio  Daño/grupo\n");
+  for (int g = 0; g < GROUPS_PER_MODE; g++) {
+    const TelGroupTotals &t = s.groups[g];
+    if (t.started == 0)
+      continue;
+    std::printf("  %5d  %7lld  %11lld  %10.1f s  %10.2f\n", g + 1, t.started,
+                t.cleared,
+                t.cleared ? t.clear_ms / 1000.0 / t.cleared : 0.0,
+                static_cast<double>(t.damage) / t.started);
   }
+  return s.sessions > 0 ? 0 : 1;
 }
 
 // Muestra la pantalla de fin de juego, true si el jugador quiere reiniciar,
 // false si quiere salir
 
-bool show_gameover() {
+bool show_gameover(GameWorld &w) {
   nodelay(stdscr, FALSE);
   clear();
-  int bw = std::min(60, screen_w - 4);
-  int bx = (screen_w - bw) / 2;
-  int by = std::max(2, screen_h / 2 - 8);
+  int bw = std::min(60, w.screen_w - 4);
+  int bx = (w.screen_w - bw) / 2;
+  int by = std::max(2, w.screen_h / 2 - 8);
   mvhline(by, bx, '=', bw);
   attron(A_BOLD);
   mvprintw(by + 1, bx + (bw / 2) - 5, "GAME OVER");
@@ -867,18 +5173,19 @@ bool show_gameover() {
   mvhline(by + 3, bx, '=', bw);
 
   // Estadisticas
-  int total_enemies =
-      (game_mode == 1) ? MODE1_TOTAL_ENEMIES : MODE2_TOTAL_ENEMIES;
-  mvprintw(by + 5, bx + 4, "Modo de juego: %d", game_mode);
-  mvprintw(by + 6, bx + 4, "Puntaje final: %d", player_score);
-  mvprintw(by + 7, bx + 4, "Enemigos eliminados: %d/%d", enemies_destroyed,
+  int total_enemies = mode_desc(w.game_mode).total_enemies();
+  mvprintw(by + 5, bx + 4, "Modo de juego: %d", w.game_mode);
+  mvprintw(by + 6, bx + 4, "Puntaje final: %d", w.player_score);
+  mvprintw(by + 7, bx + 4, "Enemigos eliminados: %d/%d", w.enemies_destroyed,
            total_enemies);
 
-  auto hs = load_highscores();
+  auto hs = load_highscores(w.game_mode);
   mvprintw(by + 9, bx + 4, "Puntuaciones mas altas:");
   for (int i = 0; i < 3; i++) {
     mvprintw(by + 11 + i, bx + 6, "%d. %d", i + 1, hs[i]);
   }
+  if (last_game_rank > 0)
+    mvprintw(by + 9, bx + 32, "(tu puesto: %d)", last_game_rank);
 
   mvprintw(by + 15, bx + 4, "Presiona 'r' para reiniciar o 'q' para salir");
   refresh();
@@ -897,13 +5204,13 @@ bool show_gameover() {
 /**
  * Muestra la pantalla de victoria
  */
-bool show_victory_screen() {
+bool show_victory_screen(GameWorld &w) {
   nodelay(stdscr, FALSE);
   clear();
 
-  int bw = std::min(70, screen_w - 4);
-  int bx = (screen_w - bw) / 2;
-  int by = std::max(2, screen_h / 2 - 10);
+  int bw = std::min(70, w.screen_w - 4);
+  int bx = (w.screen_w - bw) / 2;
+  int by = std::max(2, w.screen_h / 2 - 10);
 
   mvhline(by, bx, '=', bw);
   mvhline(by + 2, bx, '-', bw);
@@ -920,18 +5227,19 @@ bool show_victory_screen() {
   mvhline(by + 7, bx, '-', bw);
 
   // Estadísticas
-  int total_enemies =
-      (game_mode == 1) ? MODE1_TOTAL_ENEMIES : MODE2_TOTAL_ENEMIES;
-  mvprintw(by + 9, bx + 4, "Modo completado: %d", game_mode);
-  mvprintw(by + 10, bx + 4, "Puntaje final: %d", player_score);
+  int total_enemies = mode_desc(w.game_mode).total_enemies();
+  mvprintw(by + 9, bx + 4, "Modo completado: %d", w.game_mode);
+  mvprintw(by + 10, bx + 4, "Puntaje final: %d", w.player_score);
   mvprintw(by + 11, bx + 4, "Enemigos eliminados: %d/%d", total_enemies,
            total_enemies);
 
-  auto hs = load_highscores();
+  auto hs = load_highscores(w.game_mode);
   mvprintw(by + 12, bx + 4, "Mejores puntuaciones:");
   for (int i = 0; i < 3; i++) {
     mvprintw(by + 14 + i, bx + 6, "%d. %d", i + 1, hs[i]);
   }
+  if (last_game_rank > 0)
+    mvprintw(by + 12, bx + 32, "(tu puesto: %d)", last_game_rank);
 
   mvhline(by + 18, bx, '=', bw);
   mvprintw(by + 20, bx + 4,
@@ -962,11 +5270,10 @@ int select_game_mode() {
   nodelay(stdscr, FALSE);
   keypad(stdscr, TRUE);
   int choice = 0;
-  const char *items[] = {"Modo 1: 40 Alienígenas (5 grupos de 8)",
-                         "Modo 2: 50 Alienígenas (5 grupos de 10)"};
-  int nitems = 2;
+  int nitems = MAX_GAME_MODES;
 
   while (true) {
+    int screen_h, screen_w;
     getmaxyx(stdscr, screen_h, screen_w);
     clear();
     int box_w = std::min(70, screen_w - 4);
@@ -989,25 +5296,20 @@ int select_game_mode() {
     for (int i = 0; i < nitems; i++) {
       int y = start_y + i * 3;
       int x = box_x + 4;
-      if (i == choice) {
+      if (i == choice)
         attron(A_REVERSE | A_BOLD);
-        mvprintw(y, x, "%s", items[i]);
+      mvprintw(y, x, "Modo %d: %d Alienígenas (%d grupos de %d)", i + 1,
+               MODES[i].total_enemies(), GROUPS_PER_MODE, MODES[i].group_size);
+      if (i == choice)
         attroff(A_REVERSE | A_BOLD);
-      } else {
-        mvprintw(y, x, "%s", items[i]);
-      }
     }
 
     mvprintw(screen_h - 4, box_x + 2, "Descripción:");
-    if (choice == 0) {
-      mvprintw(
-          screen_h - 3, box_x + 4,
-          "40 alienígenas aparecen en 5 grupos de 8. Ganas destruyendo todos.");
-    } else {
-      mvprintw(screen_h - 3, box_x + 4,
-               "50 alienígenas aparecen en 5 grupos de 10. Ganas destruyendo "
-               "todos.");
-    }
+    mvprintw(screen_h - 3, box_x + 4,
+             "%d alienígenas aparecen en %d grupos de %d. Ganas destruyendo "
+             "todos.",
+             MODES[choice].total_enemies(), GROUPS_PER_MODE,
+             MODES[choice].group_size);
     mvprintw(
         screen_h - 2, box_x + 2,
         "Usa flechas para navegar. Enter para seleccionar. Q para volver.");
@@ -1019,7 +5321,7 @@ int select_game_mode() {
     } else if (ch == KEY_DOWN || ch == 's' || ch == 'S') {
       choice = (choice + 1) % nitems;
     } else if (ch == 10 || ch == KEY_ENTER) {
-      return choice + 1; // Retornar 1 o 2
+      return choice + 1; // Modos numerados desde 1
     } else if (ch == 'q' || ch == 'Q') {
       return -1; // Volver al menú principal
     }
@@ -1034,6 +5336,7 @@ int show_menu() {
   int nitems = 4;
   while (true) {
     // Calcula el tamaño de pantalla
+    int screen_h, screen_w;
     getmaxyx(stdscr, screen_h, screen_w);
     clear();
     int box_w = std::min(60, screen_w - 4);
@@ -1093,17 +5396,70 @@ int show_menu() {
   }
 }
 
+/**
+ * Tabla de puntajes por modo, paginada. Las filas se leen del mapeo con el
+ * bloqueo compartido tomado y la pantalla se redibuja cada
+ * HIGHSCORES_REFRESH_MS aunque no haya teclas, así se ven las partidas que
+ * otros procesos registran mientras está abierta.
+ */
 void show_highscores() {
-  nodelay(stdscr, FALSE);
-  clear();
-  auto hs = load_highscores();
-  mvprintw(3, 4, "PUNTUACIONES MAS ALTAS");
-  for (int i = 0; i < 3; i++) {
-    mvprintw(6 + i * 2, 8, "%d. %d", i + 1, hs[i]);
+  int mode = 1, page = 0;
+  timeout(HIGHSCORES_REFRESH_MS);
+  keypad(stdscr, TRUE);
+  while (true) {
+    int screen_h = getmaxy(stdscr);
+    int rows = std::max(1, screen_h - 9);
+    // erase y no clear: al refrescar solo se envía lo que cambió
+    erase();
+    mvprintw(1, 4, "PUNTUACIONES MAS ALTAS - MODO %d (de %d)", mode,
+             MAX_GAME_MODES);
+    int count = 0;
+    if (!lb_map) {
+      mvprintw(4, 4, "No se pudo abrir %s", opt_leaderboard_path);
+    } else {
+      LbLock lock(LOCK_SH);
+      const LbModeBlock &m = lb_map->modes[mode - 1];
+      const LbIndex &idx = m.index[m.active & 1];
+      count = lb_count(idx);
+      page = std::min(page, std::max(0, (count - 1) / rows));
+      mvprintw(3, 4, "%5s  %-*s %8s %6s  %-16s", "#", LB_NAME_LEN - 1,
+               "Nombre", "Puntaje", "Grupos", "Fecha");
+      for (int r = 0; r < rows && page * rows + r < count; r++) {
+        int pos = page * rows + r;
+        const LbRecord &rec = m.records[lb_slot(idx.order[pos])];
+        char date[20];
+        std::time_t t = static_cast<std::time_t>(rec.date);
+        std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M",
+                      std::localtime(&t));
+        mvprintw(4 + r, 4, "%5d  %-*.*s %8d %6d%c %-16s", pos + 1,
+                 LB_NAME_LEN - 1, LB_NAME_LEN - 1, rec.name, rec.score,
+                 rec.groups, rec.won ? '*' : ' ', date);
+      }
+      if (count == 0)
+        mvprintw(5, 4, "Todavía no hay partidas registradas.");
+    }
+    int pages = std::max(1, (count + rows - 1) / rows);
+    mvprintw(screen_h - 3, 4, "Página %d/%d - %d partidas (* = victoria)",
+             page + 1, pages, count);
+    mvprintw(screen_h - 2, 4,
+             "Izq/Der: modo  Arriba/Abajo/RePág/AvPág: página  q: volver");
+    refresh();
+    int ch = getch();
+    if (ch == KEY_LEFT || ch == 'a' || ch == 'A') {
+      mode = mode > 1 ? mode - 1 : MAX_GAME_MODES;
+      page = 0;
+    } else if (ch == KEY_RIGHT || ch == 'd' || ch == 'D') {
+      mode = mode < MAX_GAME_MODES ? mode + 1 : 1;
+      page = 0;
+    } else if (ch == KEY_UP || ch == KEY_PPAGE) {
+      page = std::max(0, page - 1);
+    } else if (ch == KEY_DOWN || ch == KEY_NPAGE) {
+      page = std::min(pages - 1, page + 1);
+    } else if (ch == 'q' || ch == 'Q' || ch == 27) {
+      timeout(-1);
+      return;
+    }
   }
-  mvprintw(screen_h - 2, 4, "Presiona cualquier tecla para volver al menu.");
-  refresh();
-  getch();
 }
 
 void show_instructions() {
@@ -1113,6 +5469,7 @@ void show_instructions() {
   mvprintw(4, 4, "A / Left  - Mover a la izquierda");
   mvprintw(5, 4, "D / Right - Mover a la derecha");
   mvprintw(6, 4, "Space / K - Disparar");
+  mvprintw(7, 4, "P         - Pausa");
   mvprintw(
       8, 4,
       "Objetivo: destruir a todos los enemigos sin perder todas tus vidas.");
@@ -1124,26 +5481,366 @@ void show_instructions() {
   getch();
 }
 
-int main() {
-  initscr();
-  cbreak();
-  noecho();
-  curs_set(0);
-  if (has_colors()) {
-    start_color();
-    use_default_colors();
-    init_pair(1, COLOR_GREEN, -1);  // Jugador
-    init_pair(2, COLOR_RED, -1);    // Enemigo
-    init_pair(3, COLOR_YELLOW, -1); // Balas
+// Hilos de una partida
+struct GameThreads {
+  std::thread input, update, autopilot;
+  std::thread player_bullet_mgr, enemy_bullet_mgr, player_bullet_collision;
+  std::thread enemy_move, enemy_shoot;
+  std::thread enemy_bullet_collision, level_checker;
+};
+
+static void start_game_threads(GameWorld &w, GameThreads &t) {
+  t.input = sim_thread(input_loop, std::ref(w));
+  t.update = sim_thread(update_loop, std::ref(w));
+  if (opt_autopilot)
+    t.autopilot = sim_thread(autopilot_loop, std::ref(w));
+  t.player_bullet_mgr = sim_thread(player_bullet_manager_thread, &w);
+  t.enemy_bullet_mgr = sim_thread(enemy_bullet_manager_thread, &w);
+  t.player_bullet_collision = sim_thread(player_bullet_collision_thread, &w);
+  t.enemy_move = sim_thread(enemy_movement_controller_thread, &w);
+  t.enemy_shoot = sim_thread(enemy_shooting_controller_thread, &w);
+  t.enemy_bullet_collision = sim_thread(enemy_bullet_collision_thread, &w);
+  t.level_checker = sim_thread(level_completion_checker_thread, &w);
+}
+
+static void join_game_threads(GameThreads &t) {
+  std::thread *all[] = {&t.input,
+                        &t.update,
+                        &t.autopilot,
+                        &t.player_bullet_mgr,
+                        &t.enemy_bullet_mgr,
+                        &t.player_bullet_collision,
+                        &t.enemy_move,
+                        &t.enemy_shoot,
+                        &t.enemy_bullet_collision,
+                        &t.level_checker};
+  for (std::thread *th : all)
+    if (th->joinable())
+      th->join();
+}
+
+static void print_usage(const char *prog) {
+  std::fprintf(stderr,
+               "Uso: %s [opciones]\n"
+               "  --stats                 Muestra bytes por cuadro enviados a "
+               "la terminal y la latencia tecla -> cuadro\n"
+               "  --low-bandwidth [B/s]   Perfil de bajo ancho de banda "
+               "(por defecto %ld B/s)\n"
+               "  --backend ncurses|ansi  Backend de salida (ansi = un solo "
+               "write() por cuadro)\n"
+               "  --autopilot             Juega automáticamente (sin terminal "
+               "corre sin interfaz)\n"
+               "  --headless              Con --autopilot: no usa la terminal\n"
+               "  --games N               Juegos a jugar con --autopilot\n"
+               "  --mode N                Modo de juego sin interfaz (1 o 2)\n"
+               "  --size AxH              Tamaño de pantalla sin interfaz "
+               "(por defecto 80x24)\n"
+               "  --batch N               Juega N partidas sin interfaz en "
+               "paralelo\n"
+               "  --jobs N                Hilos del modo por lotes (por "
+               "defecto, todos los núcleos)\n"
+               "  --seed N                Semilla inicial (partida i usa "
+               "N+i)\n"
+               "  --bench-divers [N]      Mide enemigos en picada avanzados "
+               "por ms\n"
+               "  --bench-intercept [N]   Mide la intercepción entre N balas "
+               "por lado\n"
+               "  --bench-scripts [N]     Mide N guiones de enemigos "
+               "(corrutinas) por tick\n"
+               "  --pty-bench [AxH,...]   Mide el juego real en una "
+               "pseudoterminal (por defecto %s)\n"
+               "  --pty-seconds N         Duración de cada medición de "
+               "--pty-bench (por defecto %d)\n"
+               "  --alloc-check           Falla si un tick o cuadro usa el "
+               "heap (make alloc-check)\n"
+               "  --record ARCHIVO        Graba los cuadros mostrados\n"
+               "  --play-recording ARCHIVO  Reproduce una grabación\n"
+               "  --watch [PID]           Observa una partida en curso (por "
+               "defecto, la más reciente)\n"
+               "  --no-spectators         No publica los cuadros para "
+               "--watch\n"
+               "  --load-state ARCHIVO    Empieza desde un estado guardado "
+               "(F5/F9 en el juego)\n"
+               "  --tick-ms N             Duración del tick de simulación "
+               "(%d-%d, por defecto %d)\n"
+               "  --leaderboard ARCHIVO   Tabla de puntajes compartida (por "
+               "defecto %s)\n"
+               "  --name NOMBRE           Nombre en la tabla (por defecto, "
+               "$USER)\n"
+               "  --pin-sim CPUS          Fija los hilos de simulación a "
+               "CPUS (p. ej. 2,3 o 2-3)\n"
+               "  --pin-render CPUS       Fija el hilo de render a CPUS\n"
+               "  --sched fifo|rr[:PRIO]  Prioridad de tiempo real (si se "
+               "permite)\n"
+               "  --nice N                Nivel de nice de los hilos del "
+               "juego\n"
+               "  --jitter                Informa el jitter de los ticks al "
+               "salir\n"
+               "  --trace ARCHIVO         Traza de los hilos en JSON para "
+               "Perfetto\n"
+               "  --telemetry DIR         Registra estadísticas de la sesión "
+               "en DIR\n"
+               "  --telemetry-summary ARCHIVO|DIR...  Agrega sesiones "
+               "registradas\n",
+               prog, LOWBW_DEFAULT_BYTES_PER_SEC, PTY_BENCH_DEFAULT_SIZES,
+               opt_pty_seconds, MIN_TICK_MS, MAX_TICK_MS, UPDATE_INTERVAL_MS,
+               LEADERBOARD_FILENAME);
+}
+
+// Procesa los argumentos; false si son inválidos
+static bool parse_args(int argc, char **argv) {
+  bool seed_given = false;
+  bool jobs_given = false;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    if (std::strcmp(a, "--stats") == 0) {
+      opt_stats_overlay = true;
+    } else if (std::strcmp(a, "--low-bandwidth") == 0) {
+      opt_lowbw_bytes_per_sec = LOWBW_DEFAULT_BYTES_PER_SEC;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        opt_lowbw_bytes_per_sec = std::atol(argv[++i]);
+        if (opt_lowbw_bytes_per_sec <= 0)
+          return false;
+      }
+    } else if (std::strcmp(a, "--backend") == 0 && i + 1 < argc) {
+      const char *b = argv[++i];
+      if (std::strcmp(b, "ansi") == 0)
+        opt_backend = BACKEND_ANSI;
+      else if (std::strcmp(b, "ncurses") == 0)
+        opt_backend = BACKEND_NCURSES;
+      else
+        return false;
+    } else if (std::strcmp(a, "--autopilot") == 0) {
+      opt_autopilot = true;
+    } else if (std::strcmp(a, "--headless") == 0) {
+      opt_headless = true;
+    } else if (std::strcmp(a, "--games") == 0 && i + 1 < argc) {
+      opt_autopilot_games = std::atoi(argv[++i]);
+      if (opt_autopilot_games <= 0)
+        return false;
+    } else if (std::strcmp(a, "--mode") == 0 && i + 1 < argc) {
+      opt_headless_mode = std::atoi(argv[++i]);
+      if (opt_headless_mode < 1 || opt_headless_mode > MAX_GAME_MODES)
+        return false;
+    } else if (std::strcmp(a, "--size") == 0 && i + 1 < argc) {
+      if (std::sscanf(argv[++i], "%dx%d", &opt_headless_w, &opt_headless_h) !=
+              2 ||
+          opt_headless_w < 20 || opt_headless_h < 10)
+        return false;
+    } else if (std::strcmp(a, "--batch") == 0 && i + 1 < argc) {
+      opt_batch_games = std::atoi(argv[++i]);
+      if (opt_batch_games <= 0)
+        return false;
+    } else if (std::strcmp(a, "--bench-divers") == 0) {
+      opt_bench_divers = BENCH_DIVERS_DEFAULT;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        opt_bench_divers = std::atoi(argv[++i]);
+        if (opt_bench_divers <= 0)
+          return false;
+      }
+    } else if (std::strcmp(a, "--bench-intercept") == 0) {
+      opt_bench_intercept = BENCH_INTERCEPT_DEFAULT;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        opt_bench_intercept = std::atoi(argv[++i]);
+        if (opt_bench_intercept <= 0)
+          return false;
+      }
+    } else if (std::strcmp(a, "--bench-scripts") == 0) {
+      opt_bench_scripts = BENCH_SCRIPTS_DEFAULT;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        opt_bench_scripts = std::atoi(argv[++i]);
+        if (opt_bench_scripts <= 0)
+          return false;
+      }
+    } else if (std::strcmp(a, "--pty-bench") == 0) {
+      opt_pty_bench_sizes = PTY_BENCH_DEFAULT_SIZES;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        opt_pty_bench_sizes = argv[++i];
+    } else if (std::strcmp(a, "--pty-seconds") == 0 && i + 1 < argc) {
+      opt_pty_seconds = std::atoi(argv[++i]);
+      if (opt_pty_seconds <= 0)
+        return false;
+    } else if (std::strcmp(a, "--watch") == 0) {
+      opt_watch = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        opt_watch_pid = std::atoi(argv[++i]);
+        if (opt_watch_pid <= 0)
+          return false;
+      }
+    } else if (std::strcmp(a, "--no-spectators") == 0) {
+      opt_no_spectators = true;
+    } else if (std::strcmp(a, "--alloc-check") == 0) {
+      opt_alloc_check = true;
+    } else if (std::strcmp(a, "--jobs") == 0 && i + 1 < argc) {
+      opt_batch_jobs = std::atoi(argv[++i]);
+      if (opt_batch_jobs <= 0)
+        return false;
+      jobs_given = true;
+    } else if (std::strcmp(a, "--seed") == 0 && i + 1 < argc) {
+      opt_seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      seed_given = true;
+    } else if (std::strcmp(a, "--record") == 0 && i + 1 < argc) {
+      opt_record_path = argv[++i];
+    } else if (std::strcmp(a, "--play-recording") == 0 && i + 1 < argc) {
+      opt_play_path = argv[++i];
+    } else if (std::strcmp(a, "--tick-ms") == 0 && i + 1 < argc) {
+      int ms = std::atoi(argv[++i]);
+      if (ms < MIN_TICK_MS || ms > MAX_TICK_MS)
+        return false;
+      set_tick_ms(ms);
+    } else if (std::strcmp(a, "--load-state") == 0 && i + 1 < argc) {
+      opt_load_state_path = argv[++i];
+    } else if (std::strcmp(a, "--leaderboard") == 0 && i + 1 < argc) {
+      opt_leaderboard_path = argv[++i];
+    } else if (std::strcmp(a, "--name") == 0 && i + 1 < argc) {
+      opt_player_name = argv[++i];
+    } else if (std::strcmp(a, "--pin-sim") == 0 && i + 1 < argc) {
+      if (!parse_cpu_list(argv[++i], opt_sim_cpus))
+        return false;
+      opt_pin_sim = true;
+    } else if (std::strcmp(a, "--pin-render") == 0 && i + 1 < argc) {
+      if (!parse_cpu_list(argv[++i], opt_render_cpus))
+        return false;
+      opt_pin_render = true;
+    } else if (std::strcmp(a, "--sched") == 0 && i + 1 < argc) {
+      const char *p = argv[++i];
+      if (std::strncmp(p, "fifo", 4) == 0)
+        opt_sched_policy = SCHED_FIFO;
+      else if (std::strncmp(p, "rr", 2) == 0)
+        opt_sched_policy = SCHED_RR;
+      else
+        return false;
+      const char *colon = std::strchr(p, ':');
+      opt_sched_prio = colon ? std::atoi(colon + 1) : SCHED_DEFAULT_RT_PRIO;
+      if (opt_sched_prio < sched_get_priority_min(opt_sched_policy) ||
+          opt_sched_prio > sched_get_priority_max(opt_sched_policy))
+        return false;
+    } else if (std::strcmp(a, "--nice") == 0 && i + 1 < argc) {
+      opt_nice = std::atoi(argv[++i]);
+      opt_nice_given = true;
+      if (opt_nice < -20 || opt_nice > 19)
+        return false;
+    } else if (std::strcmp(a, "--jitter") == 0) {
+      opt_jitter_report = true;
+    } else if (std::strcmp(a, "--trace") == 0 && i + 1 < argc) {
+      opt_trace_path = argv[++i];
+    } else if (std::strcmp(a, "--telemetry") == 0 && i + 1 < argc) {
+      opt_telemetry_dir = argv[++i];
+    } else if (std::strcmp(a, "--telemetry-summary") == 0 && i + 1 < argc) {
+      // El resto de los argumentos son archivos o directorios
+      opt_summary_paths = argv + i + 1;
+      opt_summary_count = argc - i - 1;
+      break;
+    } else {
+      return false;
+    }
+  }
+  if (!seed_given)
+    opt_seed = static_cast<uint32_t>(std::time(nullptr));
+  if (!jobs_given)
+    opt_batch_jobs =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (opt_summary_count >= 0)
+    return run_telemetry_summary(opt_summary_paths, opt_summary_count,
+                                 opt_batch_jobs);
+  if (opt_pty_bench_sizes)
+    return run_pty_bench(argc, argv);
+  if (opt_watch)
+    return run_watch();
+  build_dive_paths();
+  build_sprite_masks();
+  if (opt_bench_divers > 0)
+    return run_dive_benchmark(opt_bench_divers);
+  if (opt_bench_intercept > 0)
+    return run_intercept_benchmark(opt_bench_intercept);
+  if (opt_bench_scripts > 0)
+    return run_script_benchmark(opt_bench_scripts);
+  if (opt_alloc_check)
+    return run_alloc_check(opt_seed);
+
+  bool headless_autopilot =
+      opt_autopilot &&
+      (opt_headless || !isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO));
+  // Sin interfaz no hay nada que interpolar: se usa siempre el tick original
+  // para que los resultados por semilla no dependan de --tick-ms
+  if (opt_batch_games > 0 || headless_autopilot)
+    set_tick_ms(UPDATE_INTERVAL_MS);
+  if (opt_batch_games > 0)
+    return run_batch(opt_batch_games, opt_batch_jobs, opt_seed);
+  if (headless_autopilot)
+    return run_batch(opt_autopilot_games > 0 ? opt_autopilot_games : 20, 1,
+                     opt_seed);
+
+  std::unique_ptr<Recording> recording;
+  if (opt_play_path) {
+    recording.reset(new Recording);
+    if (!rec_load(opt_play_path, *recording)) {
+      std::fprintf(stderr, "No se pudo leer la grabación %s\n", opt_play_path);
+      return 1;
+    }
+  }
+  SaveImage initial_state;
+  bool start_from_state = false;
+  if (opt_load_state_path) {
+    if (!load_state_image(opt_load_state_path, initial_state)) {
+      std::fprintf(stderr, "Estado guardado inválido: %s\n",
+                   opt_load_state_path);
+      return 1;
+    }
+    start_from_state = true;
+  }
+  if (opt_record_path && !recorder_open(opt_record_path)) {
+    std::perror(opt_record_path);
+    return 1;
+  }
+  if (opt_telemetry_dir && !telemetry_open(opt_telemetry_dir)) {
+    std::perror(opt_telemetry_dir);
+    return 1;
+  }
+  if (opt_trace_path && !tracer_open(opt_trace_path)) {
+    std::perror(opt_trace_path);
+    return 1;
+  }
+  TraceThread trace_thread("render");
+  // El hilo principal es el de render
+  apply_thread_policy(opt_pin_render, opt_render_cpus);
+
+  if (!leaderboard_open(opt_leaderboard_path)) {
+    std::fprintf(stderr, "No se pudo abrir la tabla de puntajes %s\n",
+                 opt_leaderboard_path);
   }
-  getmaxyx(stdscr, screen_h, screen_w);
 
-  auto hs_init = load_highscores();
-  saved_highscore = hs_init.empty() ? 0 : hs_init[0];
+  autopilot_stats.start_ms = now_ms();
+  GameWorld world;
+  world.particles_enabled = true;
+  world.telemetry_enabled = telemetry != nullptr;
+  long long game_start_ticks = 0;
+
+  init_curses();
+
+  if (recording) {
+    play_recording(*recording);
+    endwin();
+    telemetry_close();
+    tracer_close();
+    return 0;
+  }
+  if (!opt_no_spectators && !spectate_open())
+    opt_no_spectators = true; // se juega igual, sin espectadores
 
   bool running_app = true;
   while (running_app) {
-    int choice = show_menu();
+    // Con --load-state se entra directo a la partida guardada
+    int choice = start_from_state ? MENU_PLAY : show_menu();
     clear();
     refresh();
     if (choice == MENU_QUIT)
@@ -1159,143 +5856,118 @@ int main() {
 
     // Seleccionar modo de juego
     if (choice == MENU_PLAY) {
-      int selected_mode = select_game_mode();
+      int selected_mode = start_from_state ? initial_state.world.game_mode
+                                           : select_game_mode();
       if (selected_mode == -1) {
         continue; // Volver al menú principal
       }
 
-      init_game();
-      init_game_mode(selected_mode);
-      reset_level();
+      init_game(world);
+      init_game_mode(world, selected_mode);
+      reset_level(world);
+      saved_highscore = load_highscores(selected_mode)[0];
+      if (start_from_state) {
+        apply_state(world, initial_state);
+        start_from_state = false;
+      }
 
       // Crear todos los hilos del juego (10 hilos principales)
-      std::thread t_input, t_update;
-      std::thread t_player_bullet_mgr, t_enemy_bullet_mgr,
-          t_player_bullet_collision;
-      std::thread t_enemy_move, t_enemy_shoot;
-      std::thread t_enemy_bullet_collision, t_level_checker;
-      std::thread t_game_monitor, t_score_mgr, t_visual_effects;
-
-      game_running = true;
-
-      // Iniciar todos los hilos
-      t_input = std::thread(input_loop);
-      t_update = std::thread(update_loop);
-      t_player_bullet_mgr = std::thread(player_bullet_manager_thread, nullptr);
-      t_enemy_bullet_mgr = std::thread(enemy_bullet_manager_thread, nullptr);
-      t_player_bullet_collision =
-          std::thread(player_bullet_collision_thread, nullptr);
-      t_enemy_move = std::thread(enemy_movement_controller_thread, nullptr);
-      t_enemy_shoot = std::thread(enemy_shooting_controller_thread, nullptr);
-      t_enemy_bullet_collision =
-          std::thread(enemy_bullet_collision_thread, nullptr);
-      t_level_checker = std::thread(level_completion_checker_thread, nullptr);
-      t_game_monitor = std::thread(game_state_monitor_thread, nullptr);
-      t_score_mgr = std::thread(score_manager_thread, nullptr);
-      t_visual_effects = std::thread(visual_effects_manager_thread, nullptr);
+      GameThreads threads;
+      world.game_running = true;
+      world.user_quit = false;
+      game_start_ticks = world.sim_ticks.load();
+      telemetry_game_start(world);
+      start_game_threads(world, threads);
 
       // Bucle del juego
       while (true) {
-        while (game_running.load()) {
-          draw_screen();
-          std::this_thread::sleep_for(
-              std::chrono::milliseconds(RENDER_INTERVAL_MS));
+        while (world.game_running.load()) {
+          // Solo se detiene si el cuadro recién dibujado ya muestra la pausa
+          bool paused = world.pause.paused.load();
+          draw_screen(world);
+          if (!paused || !pause_park(world.pause))
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(RENDER_INTERVAL_MS));
         }
 
         // Unir todos los hilos
-        if (t_input.joinable())
-          t_input.join();
-        if (t_update.joinable())
-          t_update.join();
-        if (t_player_bullet_mgr.joinable())
-          t_player_bullet_mgr.join();
-        if (t_enemy_bullet_mgr.joinable())
-          t_enemy_bullet_mgr.join();
-        if (t_player_bullet_collision.joinable())
-          t_player_bullet_collision.join();
-        if (t_enemy_move.joinable())
-          t_enemy_move.join();
-        if (t_enemy_shoot.joinable())
-          t_enemy_shoot.join();
-        if (t_enemy_bullet_collision.joinable())
-          t_enemy_bullet_collision.join();
-        if (t_level_checker.joinable())
-          t_level_checker.join();
-        if (t_game_monitor.joinable())
-          t_game_monitor.join();
-        if (t_score_mgr.joinable())
-          t_score_mgr.join();
-        if (t_visual_effects.joinable())
-          t_visual_effects.join();
-
-        draw_screen();
-        update_highscores_if_needed(player_score);
-        {
-          auto tmp = load_highscores();
-          saved_highscore = tmp.empty() ? 0 : tmp[0];
-        }
+        join_game_threads(threads);
+        telemetry_event(world, TEL_SRC_MAIN, TEL_GAME_END,
+                        world.game_completed, world.player_score);
+
+        draw_screen(world);
+        if (opt_backend == BACKEND_ANSI)
+          ansi_backend_release();
 
         bool restart;
-        if (game_completed) {
-          restart = show_victory_screen();
+        if (opt_autopilot && !world.user_quit.load()) {
+          // El piloto automático reinicia sin pasar por las pantallas finales
+          autopilot_record_game(game_result(
+              world, false, world.sim_ticks.load() - game_start_ticks));
+          restart = opt_autopilot_games == 0 ||
+                    autopilot_stats.games < opt_autopilot_games;
+          if (!restart)
+            running_app = false;
         } else {
-          restart = show_gameover();
+          last_game_rank = 0;
+          if (!opt_autopilot) {
+            last_game_rank = leaderboard_record_game(
+                world.game_mode, world.player_score, world.current_group,
+                world.game_completed);
+          }
+          if (world.game_completed) {
+            restart = show_victory_screen(world);
+          } else {
+            restart = show_gameover(world);
+          }
         }
 
         if (!restart)
           break;
 
         // Reiniciar el juego pero mantener el mismo modo
-        init_game();
-        reset_level();
-        game_running = true;
+        init_game(world);
+        init_game_mode(world, world.game_mode);
+        reset_level(world);
+        world.game_running = true;
+        world.user_quit = false;
 
         // Reiniciar todos los hilos (10 hilos principales)
-        t_input = std::thread(input_loop);
-        t_update = std::thread(update_loop);
-        t_player_bullet_mgr =
-            std::thread(player_bullet_manager_thread, nullptr);
-        t_enemy_bullet_mgr = std::thread(enemy_bullet_manager_thread, nullptr);
-        t_player_bullet_collision =
-            std::thread(player_bullet_collision_thread, nullptr);
-        t_enemy_move = std::thread(enemy_movement_controller_thread, nullptr);
-        t_enemy_shoot = std::thread(enemy_shooting_controller_thread, nullptr);
-        t_enemy_bullet_collision =
-            std::thread(enemy_bullet_collision_thread, nullptr);
-        t_level_checker = std::thread(level_completion_checker_thread, nullptr);
-        t_game_monitor = std::thread(game_state_monitor_thread, nullptr);
-        t_score_mgr = std::thread(score_manager_thread, nullptr);
-        t_visual_effects = std::thread(visual_effects_manager_thread, nullptr);
+        game_start_ticks = world.sim_ticks.load();
+        telemetry_game_start(world);
+        start_game_threads(world, threads);
       }
 
       // Finalizar (10 hilos principales)
-      if (t_input.joinable())
-        t_input.join();
-      if (t_update.joinable())
-        t_update.join();
-      if (t_player_bullet_mgr.joinable())
-        t_player_bullet_mgr.join();
-      if (t_enemy_bullet_mgr.joinable())
-        t_enemy_bullet_mgr.join();
-      if (t_player_bullet_collision.joinable())
-        t_player_bullet_collision.join();
-      if (t_enemy_move.joinable())
-        t_enemy_move.join();
-      if (t_enemy_shoot.joinable())
-        t_enemy_shoot.join();
-      if (t_enemy_bullet_collision.joinable())
-        t_enemy_bullet_collision.join();
-      if (t_level_checker.joinable())
-        t_level_checker.join();
-      if (t_game_monitor.joinable())
-        t_game_monitor.join();
-      if (t_score_mgr.joinable())
-        t_score_mgr.join();
-      if (t_visual_effects.joinable())
-        t_visual_effects.join();
+      join_game_threads(threads);
     } // Cierre del bloque if
   }
 
   endwin();
+  spectate_close();
+  recorder_close();
+  telemetry_close();
+  tracer_close();
+  leaderboard_close();
+  if (opt_jitter_report || opt_pin_sim || opt_pin_render ||
+      opt_sched_policy != SCHED_OTHER || opt_nice_given)
+    sched_print_report(stderr);
+
+  if (opt_autopilot) {
+    // Incluye los ticks de la partida interrumpida con 'q'
+    autopilot_stats.ticks = world.sim_ticks.load();
+    autopilot_print_summary(stderr);
+  }
+  if (opt_stats_overlay) {
+    std::fprintf(stderr,
+                 "Terminal: %lld bytes en total, %lld cuadros enviados, %lld "
+                 "fusionados, %lld bytes/cuadro promedio\n",
+                 term_bytes_total.load(), term_meter.frames_sent,
+                 term_meter.frames_skipped,
+                 term_meter.frames_sent
+                     ? term_meter.frame_bytes_sum / term_meter.frames_sent
+                     : 0);
+    input_latency_print(stderr);
+  }
   return 0;
 }